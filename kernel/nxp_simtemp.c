@@ -2,278 +2,1968 @@
 #include "nxp_simtemp.h"
 
 #include <linux/compiler.h>
+#include <linux/debugfs.h>
+#include <linux/firmware.h>
+#include <linux/fixp-arith.h>
 #include <linux/idr.h>
 #include <linux/init.h>
 #include <linux/fs.h>
-#include <linux/jiffies.h>
-#include <linux/delay.h>
+#include <linux/hrtimer.h>
+#include <linux/hwmon.h>
+#include <linux/kernel.h>
+#include <linux/kref.h>
 #include <linux/kstrtox.h>
 #include <linux/ktime.h>
+#include <linux/log2.h>
 #include <linux/minmax.h>
 #include <linux/miscdevice.h>
+#include <linux/mm.h>
 #include <linux/module.h>
 #include <linux/of.h>
+#include <linux/percpu.h>
 #include <linux/platform_device.h>
 #include <linux/poll.h>
 #include <linux/random.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/string.h>
-#include <linux/timer.h>
 #include <linux/uaccess.h>
 #include <linux/version.h>
+#include <linux/vmalloc.h>
 #include <linux/wait.h>
 
+#include <asm/byteorder.h>
+
+#define CREATE_TRACE_POINTS
+#include "nxp_simtemp_trace.h"
+
+static const char * const simtemp_stat_names[SIMTEMP_STAT_MAX] = {
+	[SIMTEMP_STAT_UPDATES] = "updates",
+	[SIMTEMP_STAT_ALERTS] = "alerts",
+	[SIMTEMP_STAT_ERRORS] = "errors",
+	[SIMTEMP_STAT_MISSED] = "missed",
+	[SIMTEMP_STAT_OVERWRITTEN] = "overwritten",
+	[SIMTEMP_STAT_READS] = "reads",
+	[SIMTEMP_STAT_WAKEUPS] = "wakeups",
+	[SIMTEMP_STAT_POLLS] = "polls",
+	[SIMTEMP_STAT_BYTES] = "bytes",
+	[SIMTEMP_STAT_OVERFLOWS] = "overflows",
+};
+
+static const char * const simtemp_overflow_names[] = {
+	[SIMTEMP_OVERFLOW_DROP_OLDEST] = "drop-oldest",
+	[SIMTEMP_OVERFLOW_DROP_NEWEST] = "drop-newest",
+	[SIMTEMP_OVERFLOW_BLOCK] = "block",
+};
+
+static const char * const simtemp_clock_names[] = {
+	[SIMTEMP_CLOCK_MONOTONIC] = "monotonic",
+	[SIMTEMP_CLOCK_BOOTTIME] = "boottime",
+	[SIMTEMP_CLOCK_MONOTONIC_RAW] = "monotonic-raw",
+	[SIMTEMP_CLOCK_REALTIME] = "realtime",
+	[SIMTEMP_CLOCK_MONOTONIC_COARSE] = "monotonic-coarse",
+	[SIMTEMP_CLOCK_REALTIME_COARSE] = "realtime-coarse",
+};
+
 static const char * const simtemp_mode_names[] = {
 	"normal",
 	"noisy",
 	"ramp",
+	"replay",
+	"sine",
+	"square",
+	"sawtooth",
+	"step",
 };
 
 #define SIMTEMP_TEMP_MIN_MC   20000
 #define SIMTEMP_TEMP_MAX_MC   80000
 #define SIMTEMP_TEMP_STEP_MC   800
 
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 6, 0)
-#define simtemp_timer_shutdown(timer) timer_shutdown_sync(timer)
-#else
-#define simtemp_timer_shutdown(timer) del_timer_sync(timer)
-#endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 13, 0)
+#define simtemp_hrtimer_setup(timer, fn, clock, mode) \
+	hrtimer_setup(timer, fn, clock, mode)
+#else
+static inline void simtemp_hrtimer_setup(struct hrtimer *timer,
+					 enum hrtimer_restart (*fn)(struct hrtimer *),
+					 clockid_t clock, enum hrtimer_mode mode)
+{
+	hrtimer_init(timer, clock, mode);
+	timer->function = fn;
+}
+#endif
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+#define simtemp_vm_flags_clear(vma, flags) vm_flags_clear(vma, flags)
+#else
+#define simtemp_vm_flags_clear(vma, flags) ((vma)->vm_flags &= ~(flags))
+#endif
+
+static bool force_create_dev;
+module_param(force_create_dev, bool, 0444);
+MODULE_PARM_DESC(force_create_dev,
+		"Create a temporary platform_device on load (for x86 dev)");
+
+static unsigned int num_devices = 1U;
+module_param(num_devices, uint, 0444);
+MODULE_PARM_DESC(num_devices,
+		 "Number of simulated sensors created by force_create_dev (1-64)");
+
+static unsigned int ring_depth = SIMTEMP_DEFAULT_RING_DEPTH;
+module_param(ring_depth, uint, 0444);
+MODULE_PARM_DESC(ring_depth,
+		 "Default ring depth in samples (power of two, overridden by DT)");
+
+static DEFINE_IDA(simtemp_ida);
+static struct class *simtemp_class;
+static struct platform_device *simtemp_pdevs[SIMTEMP_MAX_FORCED_DEVICES];
+static unsigned int simtemp_pdev_count;
+
+static void simtemp_forced_devices_unregister(void)
+{
+	while (simtemp_pdev_count > 0U) {
+		simtemp_pdev_count--;
+		platform_device_unregister(simtemp_pdevs[simtemp_pdev_count]);
+		simtemp_pdevs[simtemp_pdev_count] = NULL;
+	}
+}
+
+/*
+ * Each forced instance is its own platform_device, so it probes into an
+ * independent simtemp_device with its own ring, producer and /dev node.
+ */
+static int simtemp_forced_devices_register(unsigned int count)
+{
+	struct platform_device *pdev;
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		pdev = platform_device_register_simple(SIMTEMP_DRIVER_NAME, i,
+						       NULL, 0);
+		if (IS_ERR(pdev)) {
+			simtemp_forced_devices_unregister();
+			return PTR_ERR(pdev);
+		}
+		simtemp_pdevs[simtemp_pdev_count++] = pdev;
+	}
+
+	return 0;
+}
+
+static struct simtemp_device *simtemp_from_classdev(struct device *dev)
+{
+	return dev_get_drvdata(dev);
+}
+
+static inline struct simtemp_device *simtemp_from_timer(struct hrtimer *timer)
+{
+	return (struct simtemp_device *)((char *)timer - offsetof(struct simtemp_device, sample_timer));
+}
+
+static inline struct simtemp_device *simtemp_from_misc(struct miscdevice *misc)
+{
+	return (struct simtemp_device *)((char *)misc - offsetof(struct simtemp_device, miscdev));
+}
+
+/*
+ * Counters are bumped from the hrtimer callback as well as from process
+ * context, so the per-CPU update section has to keep interrupts out.
+ */
+static void simtemp_stat_add(struct simtemp_device *sim,
+			     enum simtemp_stat stat, u64 n)
+{
+	struct simtemp_pcpu_stats *s = get_cpu_ptr(sim->stats);
+	unsigned long flags;
+
+	flags = u64_stats_update_begin_irqsave(&s->syncp);
+	u64_stats_add(&s->cnt[stat], n);
+	u64_stats_update_end_irqrestore(&s->syncp, flags);
+	put_cpu_ptr(sim->stats);
+}
+
+static inline void simtemp_stat_inc(struct simtemp_device *sim,
+				    enum simtemp_stat stat)
+{
+	simtemp_stat_add(sim, stat, 1U);
+}
+
+static void simtemp_stats_sum(struct simtemp_device *sim,
+			      u64 totals[SIMTEMP_STAT_MAX])
+{
+	u64 snap[SIMTEMP_STAT_MAX];
+	unsigned int start;
+	int cpu, i;
+
+	memset(totals, 0, SIMTEMP_STAT_MAX * sizeof(*totals));
+
+	for_each_possible_cpu(cpu) {
+		const struct simtemp_pcpu_stats *s = per_cpu_ptr(sim->stats, cpu);
+
+		do {
+			start = u64_stats_fetch_begin(&s->syncp);
+			for (i = 0; i < SIMTEMP_STAT_MAX; i++)
+				snap[i] = u64_stats_read(&s->cnt[i]);
+		} while (u64_stats_fetch_retry(&s->syncp, start));
+
+		for (i = 0; i < SIMTEMP_STAT_MAX; i++)
+			totals[i] += snap[i];
+	}
+}
+
+static unsigned int simtemp_hist_bucket(u64 ns)
+{
+	if (!ns)
+		return 0U;
+
+	return min_t(unsigned int, fls64(ns), SIMTEMP_HIST_BUCKETS - 1U);
+}
+
+static void simtemp_hist_add(struct simtemp_device *sim,
+			     enum simtemp_hist hist, u64 ns)
+{
+	struct simtemp_pcpu_stats *s = get_cpu_ptr(sim->stats);
+	unsigned long flags;
+
+	flags = u64_stats_update_begin_irqsave(&s->syncp);
+	u64_stats_inc(&s->hist[hist][simtemp_hist_bucket(ns)]);
+	u64_stats_update_end_irqrestore(&s->syncp, flags);
+	put_cpu_ptr(sim->stats);
+}
+
+/* Account the age of a batch of records handed out at @now in one go. */
+static void simtemp_hist_add_latency(struct simtemp_device *sim,
+				     const struct simtemp_sample *batch,
+				     u32 n, u64 now)
+{
+	struct simtemp_pcpu_stats *s = get_cpu_ptr(sim->stats);
+	unsigned long flags;
+	u32 i;
+
+	flags = u64_stats_update_begin_irqsave(&s->syncp);
+	for (i = 0; i < n; i++) {
+		u64 age = now > batch[i].timestamp_ns ?
+			  now - batch[i].timestamp_ns : 0U;
+
+		u64_stats_inc(&s->hist[SIMTEMP_HIST_LATENCY][simtemp_hist_bucket(age)]);
+	}
+	u64_stats_update_end_irqrestore(&s->syncp, flags);
+	put_cpu_ptr(sim->stats);
+}
+
+static void simtemp_hist_sum(struct simtemp_device *sim, enum simtemp_hist hist,
+			     u64 totals[SIMTEMP_HIST_BUCKETS])
+{
+	u64 snap[SIMTEMP_HIST_BUCKETS];
+	unsigned int start;
+	int cpu, i;
+
+	memset(totals, 0, SIMTEMP_HIST_BUCKETS * sizeof(*totals));
+
+	for_each_possible_cpu(cpu) {
+		const struct simtemp_pcpu_stats *s = per_cpu_ptr(sim->stats, cpu);
+
+		do {
+			start = u64_stats_fetch_begin(&s->syncp);
+			for (i = 0; i < SIMTEMP_HIST_BUCKETS; i++)
+				snap[i] = u64_stats_read(&s->hist[hist][i]);
+		} while (u64_stats_fetch_retry(&s->syncp, start));
+
+		for (i = 0; i < SIMTEMP_HIST_BUCKETS; i++)
+			totals[i] += snap[i];
+	}
+}
+
+static int simtemp_stats_alloc(struct simtemp_device *sim)
+{
+	int cpu;
+
+	/* Not devm: open files still count after unbind. */
+	sim->stats = alloc_percpu(struct simtemp_pcpu_stats);
+	if (sim->stats == NULL)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu)
+		u64_stats_init(&per_cpu_ptr(sim->stats, cpu)->syncp);
+
+	return 0;
+}
+
+/*
+ * Every timestamp a device hands out, and every age computed against one,
+ * comes from its configured clock. The coarse variants return the time of
+ * the last tick without touching the clocksource, the cheapest option when
+ * stamping hundreds of thousands of samples a second.
+ */
+static u64 simtemp_clock_ns(enum simtemp_clock clock)
+{
+	switch (clock) {
+	case SIMTEMP_CLOCK_BOOTTIME:
+		return ktime_get_boottime_ns();
+	case SIMTEMP_CLOCK_MONOTONIC_RAW:
+		return ktime_get_raw_ns();
+	case SIMTEMP_CLOCK_REALTIME:
+		return ktime_get_real_ns();
+	case SIMTEMP_CLOCK_MONOTONIC_COARSE:
+		return ktime_get_coarse_ns();
+	case SIMTEMP_CLOCK_REALTIME_COARSE:
+		return ktime_get_coarse_real_ns();
+	case SIMTEMP_CLOCK_MONOTONIC:
+	default:
+		return ktime_get_ns();
+	}
+}
+
+static u64 simtemp_now_ns(const struct simtemp_device *sim)
+{
+	return simtemp_clock_ns(READ_ONCE(sim->cfg.clock));
+}
+
+static bool simtemp_buffer_has_data(const struct simtemp_reader *reader)
+{
+	if (READ_ONCE(reader->stream) == SIMTEMP_STREAM_AGGREGATE)
+		return READ_ONCE(reader->sim->agg_head) !=
+		       READ_ONCE(reader->agg_tail);
+
+	return READ_ONCE(reader->sim->ctrl->head) !=
+	       READ_ONCE(reader->ctrl->tail);
+}
+
+/* POLLPRI: crossing events this reader has not fetched yet. */
+static bool simtemp_alert_queued(const struct simtemp_reader *reader)
+{
+	return READ_ONCE(reader->sim->alert_head) != READ_ONCE(reader->alert_tail);
+}
+
+static u32 simtemp_lowat(const struct simtemp_device *sim, u32 lowat)
+{
+	return clamp(lowat, 1U, sim->ring_depth);
+}
+
+/*
+ * Readiness for poll() and blocking read(), in the spirit of SO_RCVLOWAT:
+ * enough samples queued or the oldest one has waited max_latency_us. A
+ * reader that has been lapped is always ready. Alerts have their own queue
+ * and only raise POLLPRI. Aggregates are rare enough that any one is ready.
+ */
+static bool simtemp_reader_ready(const struct simtemp_reader *reader)
+{
+	const struct simtemp_device *sim = reader->sim;
+	u32 head = smp_load_acquire(&sim->ctrl->head);
+	u32 tail = READ_ONCE(reader->ctrl->tail);
+	u32 avail = head - tail;
+	u32 max_latency_us;
+
+	if (READ_ONCE(reader->stream) == SIMTEMP_STREAM_AGGREGATE)
+		return simtemp_buffer_has_data(reader);
+	if (!avail)
+		return false;
+	if (avail >= simtemp_lowat(sim, READ_ONCE(sim->cfg.lowat)) ||
+	    avail > sim->ring_depth)
+		return true;
+
+	max_latency_us = READ_ONCE(sim->cfg.max_latency_us);
+	return max_latency_us &&
+	       simtemp_now_ns(sim) - sim->ring[tail & sim->ring_mask].timestamp_ns >=
+	       (u64)max_latency_us * NSEC_PER_USEC;
+}
+
+static void simtemp_ring_copy(const struct simtemp_device *sim,
+			      struct simtemp_sample *dst, u32 pos, u32 n)
+{
+	u32 idx = pos & sim->ring_mask;
+	u32 first = min(n, sim->ring_depth - idx);
+
+	memcpy(dst, &sim->ring[idx], first * sizeof(*dst));
+	memcpy(dst + first, sim->ring, (n - first) * sizeof(*dst));
+}
+
+static u32 simtemp_ring_depth_sanitize(struct device *dev, u32 depth,
+				       const char *what)
+{
+	u32 fixed = clamp_t(u32, depth,
+			    SIMTEMP_RING_DEPTH_MIN, SIMTEMP_RING_DEPTH_MAX);
+
+	fixed = roundup_pow_of_two(fixed);
+	if (fixed != depth)
+		dev_warn(dev, "%s adjusted to %u samples (was %u)\n",
+			 what, fixed, depth);
+
+	return fixed;
+}
+
+static struct simtemp_ring_ctrl *simtemp_ring_area_alloc(u32 depth,
+							 size_t *size)
+{
+	struct simtemp_ring_ctrl *ctrl;
+	size_t bytes = PAGE_SIZE +
+		       PAGE_ALIGN((size_t)depth * sizeof(struct simtemp_sample));
+
+	ctrl = vmalloc_user(bytes);
+	if (ctrl == NULL)
+		return NULL;
+
+	ctrl->depth = depth;
+	ctrl->record_size = sizeof(struct simtemp_sample);
+	ctrl->data_offset = PAGE_SIZE;
+	*size = bytes;
+
+	return ctrl;
+}
+
+/* The producer must not be running. */
+static void simtemp_ring_install(struct simtemp_device *sim,
+				 struct simtemp_ring_ctrl *ctrl, size_t size)
+{
+	sim->ring_area = ctrl;
+	sim->ring_area_size = size;
+	sim->ctrl = ctrl;
+	sim->ring = (struct simtemp_sample *)((char *)ctrl + PAGE_SIZE);
+	sim->ring_depth = ctrl->depth;
+	sim->ring_mask = ctrl->depth - 1U;
+	sim->head = 0U;
+	sim->wake_head = 0U;
+	sim->min_tail = 0U;
+}
+
+static int simtemp_ring_alloc(struct simtemp_device *sim)
+{
+	struct simtemp_ring_ctrl *ctrl;
+	size_t size;
+
+	ctrl = simtemp_ring_area_alloc(sim->ring_depth, &size);
+	if (ctrl == NULL)
+		return -ENOMEM;
+
+	simtemp_ring_install(sim, ctrl, size);
+
+	return 0;
+}
+
+static ktime_t simtemp_period(const struct simtemp_config *cfg)
+{
+	return us_to_ktime(cfg->sampling_us);
+}
+
+/*
+ * Re-arm the producer one period from now. Callers hold sim->lock so two
+ * restarts never race; cancelling first guarantees the callback is not
+ * running while the timer is re-queued underneath its hrtimer_forward().
+ */
+static void simtemp_restart_timer(struct simtemp_device *sim)
+{
+	lockdep_assert_held(&sim->lock);
+
+	hrtimer_cancel(&sim->sample_timer);
+	if (READ_ONCE(sim->stopping))
+		return;
+
+	hrtimer_start(&sim->sample_timer,
+		      ktime_add(ktime_get(), simtemp_period(&sim->cfg)),
+		      HRTIMER_MODE_ABS);
+}
+
+/*
+ * Put the generator back to its initial state with a fresh noise seed:
+ * cfg.seed, or a random one when that is 0. The same seed therefore
+ * replays the same waveform from the first sample on.
+ */
+static void simtemp_seed_generator(struct simtemp_device *sim)
+{
+	prandom_seed_state(&sim->rnd, sim->cfg.seed ?: get_random_u64());
+	sim->last_temp_mc = SIMTEMP_DEFAULT_THRESHOLD_MC;
+	sim->prod_mode = SIMTEMP_MODE_MAX;
+}
+
+/* Generator state belongs to the producer, so it is stopped meanwhile. */
+static void simtemp_reseed(struct simtemp_device *sim)
+{
+	lockdep_assert_held(&sim->lock);
+
+	hrtimer_cancel(&sim->sample_timer);
+	simtemp_seed_generator(sim);
+	simtemp_restart_timer(sim);
+}
+
+/*
+ * Read a replay trace: a firmware file holding little-endian s32 values in
+ * milli degrees Celsius, one per sample.
+ */
+static int simtemp_replay_load(struct simtemp_device *sim, const char *name,
+			       s32 **trace, u32 *len)
+{
+	const struct firmware *fw;
+	u32 i, n;
+	s32 *buf;
+	int ret;
+
+	ret = request_firmware(&fw, name, sim->dev);
+	if (ret)
+		return ret;
+
+	if (!fw->size || fw->size % sizeof(__le32) ||
+	    fw->size / sizeof(__le32) > SIMTEMP_REPLAY_MAX_SAMPLES) {
+		dev_warn(sim->dev, "replay trace %s: bad size %zu\n", name,
+			 fw->size);
+		release_firmware(fw);
+		return -EINVAL;
+	}
+
+	n = fw->size / sizeof(__le32);
+	buf = kvmalloc_array(n, sizeof(*buf), GFP_KERNEL);
+	if (buf == NULL) {
+		release_firmware(fw);
+		return -ENOMEM;
+	}
+	memcpy(buf, fw->data, fw->size);
+	release_firmware(fw);
+
+	for (i = 0; i < n; i++)
+		buf[i] = (s32)le32_to_cpu((__force __le32)buf[i]);
+
+	*trace = buf;
+	*len = n;
+
+	return 0;
+}
+
+/*
+ * Swap the replay trace (NULL to drop it). The producer is stopped while
+ * the pointer changes and playback restarts from the first value.
+ */
+static void simtemp_replay_install(struct simtemp_device *sim, s32 *trace,
+				   u32 len, const char *name)
+{
+	s32 *old;
+
+	lockdep_assert_held(&sim->lock);
+
+	hrtimer_cancel(&sim->sample_timer);
+	old = sim->replay;
+	sim->replay = trace;
+	sim->replay_len = len;
+	sim->replay_pos = 0U;
+	strscpy(sim->replay_name, name, sizeof(sim->replay_name));
+	simtemp_restart_timer(sim);
+
+	kvfree(old);
+}
+
+static void simtemp_replay_free(struct simtemp_device *sim)
+{
+	kvfree(sim->replay);
+	sim->replay = NULL;
+	sim->replay_len = 0U;
+}
+
+/* Producer side: a consistent copy of the configuration for this tick. */
+static void simtemp_cfg_snapshot(struct simtemp_device *sim,
+				 struct simtemp_config *cfg)
+{
+	unsigned int seq;
+
+	do {
+		seq = read_seqbegin(&sim->cfg_lock);
+		*cfg = sim->cfg;
+	} while (read_seqretry(&sim->cfg_lock, seq));
+}
+
+static int simtemp_cfg_validate(const struct simtemp_device *sim,
+				const struct simtemp_config *cfg)
+{
+	int i;
+
+	if (cfg->sampling_us < SIMTEMP_SAMPLING_US_MIN ||
+	    cfg->sampling_us > SIMTEMP_SAMPLING_US_MAX)
+		return -EINVAL;
+	if (!sim->hres && cfg->sampling_us < 1000U)
+		return -EINVAL;
+	if (cfg->mode >= SIMTEMP_MODE_MAX ||
+	    (cfg->mode == SIMTEMP_MODE_REPLAY && !READ_ONCE(sim->replay_len)) ||
+	    cfg->overflow_policy >= SIMTEMP_OVERFLOW_MAX ||
+	    cfg->clock >= SIMTEMP_CLOCK_MAX)
+		return -EINVAL;
+	if (!cfg->lowat || cfg->max_latency_us > SIMTEMP_MAX_LATENCY_US_MAX)
+		return -EINVAL;
+	if (!cfg->burst || cfg->burst > SIMTEMP_BURST_MAX)
+		return -EINVAL;
+	if (cfg->wave_amplitude_mc > SIMTEMP_WAVE_AMPLITUDE_MAX ||
+	    cfg->wave_offset_mc < SIMTEMP_WAVE_OFFSET_MIN ||
+	    cfg->wave_offset_mc > SIMTEMP_WAVE_OFFSET_MAX ||
+	    cfg->wave_period < SIMTEMP_WAVE_PERIOD_MIN ||
+	    cfg->wave_period > SIMTEMP_WAVE_PERIOD_MAX)
+		return -EINVAL;
+	if (cfg->hysteresis_mc > SIMTEMP_HYSTERESIS_MC_MAX ||
+	    cfg->agg_window > SIMTEMP_AGG_WINDOW_MAX)
+		return -EINVAL;
+	for (i = 0; i < ARRAY_SIZE(cfg->reserved); i++) {
+		if (cfg->reserved[i])
+			return -EINVAL;
+	}
+
+	return 0;
+}
+
+/*
+ * Publish a new configuration in one step. The write side disables
+ * interrupts so the hrtimer callback cannot spin on a half-written copy
+ * on this CPU. The producer is only re-armed when the period or the seed
+ * changed.
+ */
+static void simtemp_cfg_apply(struct simtemp_device *sim,
+			      const struct simtemp_config *cfg)
+{
+	bool period_changed, seed_changed;
+
+	lockdep_assert_held(&sim->lock);
+
+	period_changed = cfg->sampling_us != sim->cfg.sampling_us;
+	seed_changed = cfg->seed != sim->cfg.seed;
+
+	write_seqlock_irq(&sim->cfg_lock);
+	sim->cfg = *cfg;
+	write_sequnlock_irq(&sim->cfg_lock);
+
+	if (seed_changed)
+		simtemp_reseed(sim);
+	else if (period_changed)
+		simtemp_restart_timer(sim);
+}
+
+/*
+ * Swap in a ring of a different depth. Only legal while nobody has the
+ * device open (and therefore mapped); queued samples are discarded.
+ */
+static int simtemp_ring_resize(struct simtemp_device *sim, u32 depth)
+{
+	struct simtemp_ring_ctrl *ctrl;
+	void *old;
+	size_t size;
+
+	lockdep_assert_held(&sim->lock);
+
+	if (sim->open_count)
+		return -EBUSY;
+	if (depth == sim->ring_depth)
+		return 0;
+
+	ctrl = simtemp_ring_area_alloc(depth, &size);
+	if (ctrl == NULL)
+		return -ENOMEM;
+
+	hrtimer_cancel(&sim->sample_timer);
+	old = sim->ring_area;
+	simtemp_ring_install(sim, ctrl, size);
+	simtemp_restart_timer(sim);
+
+	vfree(old);
+
+	return 0;
+}
+
+static void simtemp_ring_free(struct simtemp_device *sim)
+{
+	vfree(sim->ring_area);
+	sim->ring_area = NULL;
+	sim->ctrl = NULL;
+	sim->ring = NULL;
+}
+
+/* Runs in the producer the first time it sees a new mode. */
+static void simtemp_enter_mode(struct simtemp_device *sim, enum simtemp_mode mode)
+{
+	sim->prod_mode = mode;
+	sim->ramp_increasing = true;
+	sim->replay_pos = 0U;
+	if (mode == SIMTEMP_MODE_RAMP)
+		sim->last_temp_mc = SIMTEMP_TEMP_MIN_MC;
+}
+
+/*
+ * Samples the generator can still produce: unlimited except for a one-shot
+ * replay, which ends with its trace (or never starts without one).
+ */
+static u32 simtemp_replay_remaining(const struct simtemp_device *sim,
+				    const struct simtemp_config *cfg)
+{
+	if (cfg->mode != SIMTEMP_MODE_REPLAY)
+		return U32_MAX;
+	if (!sim->replay_len)
+		return 0U;
+	if (cfg->replay_loop)
+		return U32_MAX;
+	if (sim->prod_mode != SIMTEMP_MODE_REPLAY)
+		return sim->replay_len;
+
+	return sim->replay_len - sim->replay_pos;
+}
+
+static bool simtemp_mode_is_periodic(enum simtemp_mode mode)
+{
+	return mode >= SIMTEMP_MODE_SINE && mode <= SIMTEMP_MODE_STEP;
+}
+
+/*
+ * Tabulate one period of the selected waveform, scaled to the configured
+ * amplitude and offset, so generating a sample is a single table load.
+ * Rebuilt only when the mode or a wave_* parameter changes.
+ */
+static void simtemp_wave_setup(struct simtemp_device *sim,
+			       const struct simtemp_config *cfg)
+{
+	s32 amp = cfg->wave_amplitude_mc;
+	s32 offset = cfg->wave_offset_mc;
+	u32 i;
+
+	for (i = 0; i < SIMTEMP_WAVE_LUT_SIZE; i++) {
+		s32 v;
+
+		switch (cfg->mode) {
+		case SIMTEMP_MODE_SINE:
+			v = (s32)(((s64)amp *
+				   fixp_sin32_rad(i, SIMTEMP_WAVE_LUT_SIZE)) >> 31);
+			break;
+		case SIMTEMP_MODE_SQUARE:
+			v = i < SIMTEMP_WAVE_LUT_SIZE / 2 ? amp : -amp;
+			break;
+		case SIMTEMP_MODE_SAWTOOTH:
+			v = -amp + (s32)div_s64(2LL * amp * i,
+						SIMTEMP_WAVE_LUT_SIZE - 1);
+			break;
+		case SIMTEMP_MODE_STEP:
+		default:
+			v = -amp + 2 * amp * (s32)(i / 32U) / 7;
+			break;
+		}
+		sim->wave_lut[i] = offset + v;
+	}
+
+	sim->wave_amplitude_mc = cfg->wave_amplitude_mc;
+	sim->wave_offset_mc = cfg->wave_offset_mc;
+	sim->wave_period = cfg->wave_period;
+	sim->wave_idx = 0U;
+	sim->wave_frac = 0U;
+}
+
+/*
+ * Walk the table at 256 / period entries per sample without dividing:
+ * the whole part is added directly and the remainder accumulated until it
+ * carries, so after exactly one period the index is back where it started.
+ */
+static s32 simtemp_wave_next(struct simtemp_device *sim)
+{
+	u32 period = sim->wave_period;
+	s32 temp = sim->wave_lut[sim->wave_idx];
+	u32 idx = sim->wave_idx + SIMTEMP_WAVE_LUT_SIZE / period;
+
+	sim->wave_frac += SIMTEMP_WAVE_LUT_SIZE % period;
+	if (sim->wave_frac >= period) {
+		sim->wave_frac -= period;
+		idx++;
+	}
+	sim->wave_idx = idx % SIMTEMP_WAVE_LUT_SIZE;
+
+	return temp;
+}
+
+static enum simtemp_mode simtemp_mode_from_string(const char *str)
+{
+	int i;
+
+	for (i = 0; i < SIMTEMP_MODE_MAX; i++) {
+		if (sysfs_streq(str, simtemp_mode_names[i]))
+			return i;
+	}
+
+	return SIMTEMP_MODE_MAX;
+}
+
+static s32 simtemp_generate_temp(struct simtemp_device *sim,
+				 const struct simtemp_config *cfg)
+{
+	enum simtemp_mode mode = cfg->mode;
+	s32 temp;
+
+	if (mode != sim->prod_mode) {
+		simtemp_enter_mode(sim, mode);
+		if (simtemp_mode_is_periodic(mode))
+			simtemp_wave_setup(sim, cfg);
+	}
+	temp = sim->last_temp_mc;
+
+	if (simtemp_mode_is_periodic(mode)) {
+		if (cfg->wave_amplitude_mc != sim->wave_amplitude_mc ||
+		    cfg->wave_offset_mc != sim->wave_offset_mc ||
+		    cfg->wave_period != sim->wave_period)
+			simtemp_wave_setup(sim, cfg);
+		/* Like replay, the waveform is exact rather than clamped. */
+		temp = simtemp_wave_next(sim);
+		sim->last_temp_mc = temp;
+		return temp;
+	}
+
+	switch (mode) {
+	case SIMTEMP_MODE_NORMAL: {
+		s32 delta = (s32)reciprocal_scale(prandom_u32_state(&sim->rnd),
+						  2 * SIMTEMP_TEMP_STEP_MC + 1) -
+			 SIMTEMP_TEMP_STEP_MC;
+		temp += delta;
+		break;
+	}
+	case SIMTEMP_MODE_NOISY: {
+		s32 delta = (s32)reciprocal_scale(prandom_u32_state(&sim->rnd),
+						  6 * SIMTEMP_TEMP_STEP_MC + 1) -
+			 (3 * SIMTEMP_TEMP_STEP_MC);
+		temp += delta;
+		break;
+	}
+	case SIMTEMP_MODE_REPLAY:
+		/* Recorded values are played back as is, without clamping. */
+		if (sim->replay_pos >= sim->replay_len)
+			sim->replay_pos = 0U;
+		temp = sim->replay[sim->replay_pos++];
+		sim->last_temp_mc = temp;
+		return temp;
+	case SIMTEMP_MODE_RAMP:
+	default: {
+		bool ramp_up = sim->ramp_increasing;
+
+		if (ramp_up)
+			temp += SIMTEMP_TEMP_STEP_MC;
+		else
+			temp -= SIMTEMP_TEMP_STEP_MC;
+		if (temp >= SIMTEMP_TEMP_MAX_MC) {
+			temp = SIMTEMP_TEMP_MAX_MC;
+			ramp_up = false;
+		} else if (temp <= SIMTEMP_TEMP_MIN_MC) {
+			temp = SIMTEMP_TEMP_MIN_MC;
+			ramp_up = true;
+		}
+		sim->ramp_increasing = ramp_up;
+		break;
+	}
+	}
+
+	temp = clamp_t(s32, temp, SIMTEMP_TEMP_MIN_MC, SIMTEMP_TEMP_MAX_MC);
+	sim->last_temp_mc = temp;
+
+	return temp;
+}
+
+/*
+ * Single producer, lock free: only the hrtimer callback writes the ring and
+ * head, and readers only ever write their own cursor.
+ */
+static void simtemp_ring_store(struct simtemp_device *sim, u32 idx,
+			       const struct simtemp_sample *sample)
+{
+	sim->ring[idx & sim->ring_mask] = *sample;
+}
+
+/*
+ * Latest-value fast path for pollers that must not consume from the ring:
+ * one seqcount-protected copy per tick, written only by the producer, so
+ * readers never block it and retry only if they race with that copy.
+ */
+static void simtemp_latest_publish(struct simtemp_device *sim,
+				   const struct simtemp_sample *sample)
+{
+	write_seqcount_begin(&sim->latest_seq);
+	sim->latest = *sample;
+	write_seqcount_end(&sim->latest_seq);
+}
+
+static bool simtemp_latest_read(struct simtemp_device *sim,
+				struct simtemp_sample *out)
+{
+	unsigned int seq;
+
+	do {
+		seq = read_seqcount_begin(&sim->latest_seq);
+		*out = sim->latest;
+	} while (read_seqcount_retry(&sim->latest_seq, seq));
+
+	return out->flags & SIMTEMP_SAMPLE_FLAG_NEW_SAMPLE;
+}
+
+/*
+ * Edge-triggered alerts: the alert goes active when a sample reaches the
+ * threshold and only clears once one drops below threshold - hysteresis,
+ * so a value hovering around the threshold produces a single pair of
+ * events. Each edge is appended to the alert queue; readers that fall
+ * more than a queue behind lose the oldest events and are told so.
+ */
+static void simtemp_alert_update(struct simtemp_device *sim,
+				 const struct simtemp_config *cfg,
+				 struct simtemp_sample *sample)
+{
+	struct simtemp_alert *event;
+	unsigned long flags;
+	u32 edge;
+
+	if (!sim->alert_active && sample->temp_mc >= cfg->threshold_mc) {
+		sim->alert_active = true;
+		edge = SIMTEMP_SAMPLE_FLAG_ALERT_RISING;
+		simtemp_stat_inc(sim, SIMTEMP_STAT_ALERTS);
+	} else if (sim->alert_active &&
+		   (s64)sample->temp_mc <
+		   (s64)cfg->threshold_mc - cfg->hysteresis_mc) {
+		sim->alert_active = false;
+		edge = SIMTEMP_SAMPLE_FLAG_ALERT_FALLING;
+	} else {
+		edge = 0U;
+	}
+
+	if (sim->alert_active)
+		sample->flags |= SIMTEMP_SAMPLE_FLAG_THRESHOLD_ALERT;
+	if (!edge)
+		return;
+	sample->flags |= edge;
+
+	spin_lock_irqsave(&sim->alert_lock, flags);
+	event = &sim->alerts[sim->alert_head % SIMTEMP_ALERT_QUEUE_DEPTH];
+	event->timestamp_ns = sample->timestamp_ns;
+	event->seq = sample->seq;
+	event->temp_mc = sample->temp_mc;
+	event->flags = edge;
+	event->lost = 0U;
+	event->reserved = 0U;
+	WRITE_ONCE(sim->alert_head, sim->alert_head + 1U);
+	spin_unlock_irqrestore(&sim->alert_lock, flags);
+}
+
+/*
+ * Fold one generated sample into the current aggregation window and queue
+ * the summary once the window is full. Only O(1) state is kept (running
+ * min, max and sum), so the window length costs nothing. A new window
+ * length discards the partial window.
+ */
+static void simtemp_agg_update(struct simtemp_device *sim,
+			       const struct simtemp_config *cfg,
+			       const struct simtemp_sample *sample)
+{
+	struct simtemp_aggregate *agg = &sim->agg;
+	unsigned long flags;
+
+	if (cfg->agg_window != sim->agg_window) {
+		sim->agg_window = cfg->agg_window;
+		agg->count = 0U;
+	}
+	if (!sim->agg_window)
+		return;
+
+	if (!agg->count) {
+		agg->first_seq = sample->seq;
+		agg->min_mc = sample->temp_mc;
+		agg->max_mc = sample->temp_mc;
+		agg->flags = 0U;
+		sim->agg_sum = 0;
+	}
+	agg->min_mc = min(agg->min_mc, sample->temp_mc);
+	agg->max_mc = max(agg->max_mc, sample->temp_mc);
+	agg->flags |= sample->flags & SIMTEMP_SAMPLE_FLAG_THRESHOLD_ALERT;
+	sim->agg_sum += sample->temp_mc;
+	if (++agg->count < sim->agg_window)
+		return;
+
+	agg->timestamp_ns = sample->timestamp_ns;
+	agg->mean_mc = (s32)div_s64(sim->agg_sum, agg->count);
+	agg->reserved = 0U;
+
+	spin_lock_irqsave(&sim->agg_lock, flags);
+	sim->aggs[sim->agg_head % SIMTEMP_AGG_QUEUE_DEPTH] = *agg;
+	WRITE_ONCE(sim->agg_head, sim->agg_head + 1U);
+	spin_unlock_irqrestore(&sim->agg_lock, flags);
+
+	agg->count = 0U;
+}
+
+/*
+ * Every open file has its own cursor and waitqueue, so each one holding
+ * unread data is woken, but within a file only as many exclusive waiters
+ * (blocking read() or EPOLLEXCLUSIVE) as there are lowat-sized batches to
+ * hand out. Keyed wakeups let epoll skip entries not waiting for the event.
+ * Alerts are rare and wake everyone waiting on the file, but only on the
+ * tick that queued them: an event left unfetched keeps POLLPRI asserted
+ * without waking the file again on every tick.
+ */
+static void simtemp_wake_reader(struct simtemp_device *sim,
+				struct simtemp_reader *reader, bool due,
+				bool alerts, bool aggs)
+{
+	u32 avail;
+	int nr;
+
+	/* wq_has_sleeper() orders the head stores against the waiter check. */
+	if (!wq_has_sleeper(&reader->waitq))
+		return;
+
+	if (alerts && simtemp_alert_queued(reader)) {
+		__wake_up(&reader->waitq, TASK_INTERRUPTIBLE, 0,
+			  poll_to_key(EPOLLPRI));
+		simtemp_stat_inc(sim, SIMTEMP_STAT_WAKEUPS);
+	}
+
+	if (READ_ONCE(reader->stream) == SIMTEMP_STREAM_AGGREGATE) {
+		if (!aggs)
+			return;
+		avail = sim->agg_head - READ_ONCE(reader->agg_tail);
+		nr = min_t(u32, avail, SIMTEMP_AGG_QUEUE_DEPTH);
+	} else {
+		if (!due)
+			return;
+		avail = min(sim->head - READ_ONCE(reader->ctrl->tail),
+			    sim->ring_depth);
+		nr = DIV_ROUND_UP(avail, simtemp_lowat(sim, READ_ONCE(sim->cfg.lowat)));
+	}
+	if (!nr)
+		return;
+
+	__wake_up(&reader->waitq, TASK_INTERRUPTIBLE, nr,
+		  poll_to_key(EPOLLIN | EPOLLRDNORM));
+	simtemp_stat_inc(sim, SIMTEMP_STAT_WAKEUPS);
+}
+
+/*
+ * Coalesce wakeups: sleeping readers are only woken once lowat samples
+ * have been published since the last wakeup or the oldest has been
+ * waiting max_latency_us. Checked once per tick, so the latency bound has
+ * the granularity of the sampling period. A full ring always wakes: under
+ * the block policy nothing else would. A new alert event or aggregate
+ * wakes waiters without restarting the data coalescing window.
+ */
+static void simtemp_maybe_wake(struct simtemp_device *sim,
+			       const struct simtemp_config *cfg, u64 now,
+			       bool full)
+{
+	u32 pending = sim->head - sim->wake_head;
+	bool alerts = sim->alert_head != sim->wake_alert;
+	bool aggs = sim->agg_head != sim->wake_agg;
+	bool event = alerts || aggs;
+	struct simtemp_reader *reader;
+	unsigned long flags;
+	bool due;
+
+	due = pending &&
+	      (full || pending >= simtemp_lowat(sim, cfg->lowat) ||
+	       (cfg->max_latency_us &&
+		now - sim->pending_since >= (u64)cfg->max_latency_us * NSEC_PER_USEC));
+	if (!due && !event)
+		return;
+
+	if (due)
+		sim->wake_head = sim->head;
+	sim->wake_alert = sim->alert_head;
+	sim->wake_agg = sim->agg_head;
+
+	spin_lock_irqsave(&sim->readers_lock, flags);
+	list_for_each_entry(reader, &sim->readers, node)
+		simtemp_wake_reader(sim, reader, due, alerts, aggs);
+	spin_unlock_irqrestore(&sim->readers_lock, flags);
+}
+
+/*
+ * How many of @want records can be published at @head without overwriting
+ * one some reader has not consumed yet? The answer is cached in min_tail,
+ * so the reader list is only walked when the ring looks full against the
+ * last known slowest cursor. A cursor more than a ring behind (only
+ * possible through a bogus mmap() write) does not hold the producer back.
+ */
+static u32 simtemp_ring_space(struct simtemp_device *sim, u32 head, u32 want)
+{
+	struct simtemp_reader *reader;
+	unsigned long flags;
+	u32 depth = sim->ring_depth;
+	u32 oldest = head;
+
+	if (head - sim->min_tail + want <= depth)
+		return want;
+
+	spin_lock_irqsave(&sim->readers_lock, flags);
+	list_for_each_entry(reader, &sim->readers, node) {
+		u32 tail;
+
+		if (READ_ONCE(reader->stream) != SIMTEMP_STREAM_RAW)
+			continue;
+		tail = smp_load_acquire(&reader->ctrl->tail);
+
+		if (head - tail <= depth && head - tail > head - oldest)
+			oldest = tail;
+	}
+	spin_unlock_irqrestore(&sim->readers_lock, flags);
+
+	sim->min_tail = oldest;
+
+	return min(want, depth - (head - oldest));
+}
+
+/*
+ * Generate one tick's worth of samples: cfg->burst of them, timestamped
+ * evenly across the period that just ended, written to the ring and then
+ * published with a single head update. Slots are claimed before they are
+ * overwritten so lock-free readers can tell which copies went stale.
+ * Returns true when the tick found the ring full for the slowest reader.
+ */
+static bool simtemp_produce_samples(struct simtemp_device *sim,
+				    const struct simtemp_config *cfg)
+{
+	enum simtemp_overflow_policy policy = cfg->overflow_policy;
+	struct simtemp_sample sample = { 0 };
+	u32 head = sim->head;
+	u32 burst = min3(cfg->burst, sim->ring_depth,
+			 simtemp_replay_remaining(sim, cfg));
+	u32 room = burst;
+	bool full = false;
+	u64 now, step;
+	u32 i;
+
+	if (policy != SIMTEMP_OVERFLOW_DROP_OLDEST) {
+		room = simtemp_ring_space(sim, head, burst);
+		if (room < burst) {
+			full = true;
+			simtemp_stat_inc(sim, SIMTEMP_STAT_OVERFLOWS);
+			trace_simtemp_overflow(sim->id, head, burst, room, policy);
+			/* Blocking stalls the stream: nothing beyond room is generated. */
+			if (policy == SIMTEMP_OVERFLOW_BLOCK)
+				burst = room;
+		}
+	}
+	if (!burst)
+		return full;
+
+	if (room) {
+		WRITE_ONCE(sim->ctrl->claim, head + room);
+		smp_wmb();
+	}
+
+	now = simtemp_clock_ns(cfg->clock);
+	if (cfg->clock != sim->prod_clock) {
+		/* Ages measured on the old clock are meaningless on the new one. */
+		sim->prod_clock = cfg->clock;
+		sim->pending_since = now;
+	}
+	/* Spread what is actually generated, so the last one lands on now. */
+	step = div_u64((u64)cfg->sampling_us * NSEC_PER_USEC, burst);
+
+	for (i = 0; i < burst; i++) {
+		s32 temp = simtemp_generate_temp(sim, cfg);
+
+		sample.timestamp_ns = now - (u64)(burst - 1U - i) * step;
+		sample.temp_mc = temp;
+		sample.flags = SIMTEMP_SAMPLE_FLAG_NEW_SAMPLE;
+		sample.seq = sim->seq++;
+		simtemp_alert_update(sim, cfg, &sample);
+		simtemp_agg_update(sim, cfg, &sample);
+		trace_simtemp_sample(sim->id, &sample);
+
+		/* Drop-newest: the sample consumed a sequence number, leaving a gap. */
+		if (i < room)
+			simtemp_ring_store(sim, head + i, &sample);
+	}
+	simtemp_latest_publish(sim, &sample);
+
+	if (!room)
+		return full;
+
+	if (head == sim->wake_head)
+		sim->pending_since = now - (u64)(burst - 1U) * step;
+	simtemp_stat_add(sim, SIMTEMP_STAT_UPDATES, room);
+
+	sim->head = head + room;
+	smp_store_release(&sim->ctrl->head, sim->head);
+	trace_simtemp_publish(sim->id, sim->head, room, burst - room,
+			      sim->ring_depth);
+
+	return full;
+}
+
+static enum hrtimer_restart simtemp_timer_cb(struct hrtimer *t)
+{
+	struct simtemp_device *sim = simtemp_from_timer(t);
+	struct simtemp_config cfg;
+	ktime_t late;
+	u64 overruns;
+	bool full;
+
+	if (READ_ONCE(sim->stopping))
+		return HRTIMER_NORESTART;
+
+	late = ktime_sub(ktime_get(), hrtimer_get_expires(t));
+	simtemp_hist_add(sim, SIMTEMP_HIST_JITTER,
+			 ktime_to_ns(late) > 0 ? ktime_to_ns(late) : 0);
+
+	simtemp_cfg_snapshot(sim, &cfg);
+	full = simtemp_produce_samples(sim, &cfg);
+	simtemp_maybe_wake(sim, &cfg, simtemp_clock_ns(cfg.clock), full);
+
+	/*
+	 * Advance from the previous expiry, not from now, so the period does
+	 * not stretch by the callback latency. Whole periods that already
+	 * elapsed are skipped and accounted as missed.
+	 */
+	overruns = hrtimer_forward_now(t, simtemp_period(&cfg));
+	if (overruns > 1U)
+		simtemp_stat_add(sim, SIMTEMP_STAT_MISSED, overruns - 1U);
+
+	return HRTIMER_RESTART;
+}
+
+static ssize_t sampling_ms_show(struct device *dev,
+					struct device_attribute *attr, char *buf)
+{
+	struct simtemp_device *sim;
+	u32 sampling;
+
+	sim = simtemp_from_classdev(dev);
+	if (sim == NULL)
+		return -ENODEV;
+
+	mutex_lock(&sim->lock);
+	sampling = DIV_ROUND_CLOSEST(sim->cfg.sampling_us, 1000U);
+	mutex_unlock(&sim->lock);
+
+	return sysfs_emit(buf, "%u\n", sampling);
+}
+
+static ssize_t sampling_ms_store(struct device *dev,
+				struct device_attribute *attr,
+				 const char *buf, size_t count)
+{
+	struct simtemp_device *sim;
+	struct simtemp_config cfg;
+	unsigned int value;
+	unsigned int clamped;
+	int ret;
+
+	sim = simtemp_from_classdev(dev);
+	if (sim == NULL)
+		return -ENODEV;
+
+	ret = kstrtouint(buf, 0, &value);
+	if (ret != 0)
+		return ret;
+
+	clamped = clamp_t(unsigned int, value,
+			 SIMTEMP_SAMPLING_MS_MIN, SIMTEMP_SAMPLING_MS_MAX);
+
+	mutex_lock(&sim->lock);
+	if (clamped != value)
+		dev_warn(sim->dev,
+			 "sampling_ms clamped to %u ms (was %u)\n",
+			 clamped, value);
+	cfg = sim->cfg;
+	cfg.sampling_us = clamped * 1000U;
+	simtemp_cfg_apply(sim, &cfg);
+	mutex_unlock(&sim->lock);
+
+	return count;
+}
+static DEVICE_ATTR_RW(sampling_ms);
+
+static ssize_t sampling_us_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	struct simtemp_device *sim = simtemp_from_classdev(dev);
+	u32 sampling;
+
+	if (sim == NULL)
+		return -ENODEV;
+
+	mutex_lock(&sim->lock);
+	sampling = sim->cfg.sampling_us;
+	mutex_unlock(&sim->lock);
+
+	return sysfs_emit(buf, "%u\n", sampling);
+}
+
+static ssize_t sampling_us_store(struct device *dev,
+				 struct device_attribute *attr,
+				 const char *buf, size_t count)
+{
+	struct simtemp_device *sim = simtemp_from_classdev(dev);
+	struct simtemp_config cfg;
+	u32 value;
+	u32 clamped;
+	int ret;
+
+	if (sim == NULL)
+		return -ENODEV;
+
+	ret = kstrtouint(buf, 0, &value);
+	if (ret != 0)
+		return ret;
+
+	clamped = clamp_t(u32, value,
+			 SIMTEMP_SAMPLING_US_MIN, SIMTEMP_SAMPLING_US_MAX);
+
+	if (clamped != value)
+		dev_warn(sim->dev,
+			 "sampling_us clamped to %u us (was %u)\n",
+			 clamped, value);
+
+	if (!sim->hres && clamped < 1000U) {
+		dev_warn(sim->dev,
+			 "sampling_us=%u us requested but high-res timers unavailable; rounding up to 1000 us\n",
+			 clamped);
+		clamped = 1000U;
+	}
+
+	mutex_lock(&sim->lock);
+	cfg = sim->cfg;
+	cfg.sampling_us = clamped;
+	simtemp_cfg_apply(sim, &cfg);
+	mutex_unlock(&sim->lock);
+
+	return count;
+}
+static DEVICE_ATTR_RW(sampling_us);
+
+static ssize_t threshold_mC_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct simtemp_device *sim;
+	s32 threshold;
+
+	sim = simtemp_from_classdev(dev);
+	if (sim == NULL)
+		return -ENODEV;
+
+	mutex_lock(&sim->lock);
+	threshold = sim->cfg.threshold_mc;
+	mutex_unlock(&sim->lock);
+
+	return sysfs_emit(buf, "%d\n", threshold);
+}
+
+static ssize_t threshold_mC_store(struct device *dev,
+				struct device_attribute *attr,
+				 const char *buf, size_t count)
+{
+	struct simtemp_device *sim;
+	struct simtemp_config cfg;
+	int value;
+	int ret;
+
+	sim = simtemp_from_classdev(dev);
+	if (sim == NULL)
+		return -ENODEV;
+
+	ret = kstrtoint(buf, 0, &value);
+	if (ret != 0)
+		return ret;
+
+	mutex_lock(&sim->lock);
+	cfg = sim->cfg;
+	cfg.threshold_mc = value;
+	simtemp_cfg_apply(sim, &cfg);
+	mutex_unlock(&sim->lock);
+
+	return count;
+}
+static DEVICE_ATTR_RW(threshold_mC);
+
+static ssize_t temp_mC_show(struct device *dev,
+			    struct device_attribute *attr, char *buf)
+{
+	struct simtemp_device *sim = simtemp_from_classdev(dev);
+	struct simtemp_sample sample;
+
+	if (sim == NULL)
+		return -ENODEV;
+	if (!simtemp_latest_read(sim, &sample))
+		return -ENODATA;
+
+	return sysfs_emit(buf, "%d\n", sample.temp_mc);
+}
+static DEVICE_ATTR_RO(temp_mC);
+
+static ssize_t hysteresis_mC_show(struct device *dev,
+				  struct device_attribute *attr, char *buf)
+{
+	struct simtemp_device *sim = simtemp_from_classdev(dev);
+	u32 hysteresis;
+
+	if (sim == NULL)
+		return -ENODEV;
+
+	mutex_lock(&sim->lock);
+	hysteresis = sim->cfg.hysteresis_mc;
+	mutex_unlock(&sim->lock);
+
+	return sysfs_emit(buf, "%u\n", hysteresis);
+}
+
+static ssize_t hysteresis_mC_store(struct device *dev,
+				   struct device_attribute *attr,
+				   const char *buf, size_t count)
+{
+	struct simtemp_device *sim = simtemp_from_classdev(dev);
+	struct simtemp_config cfg;
+	u32 value;
+	u32 clamped;
+	int ret;
+
+	if (sim == NULL)
+		return -ENODEV;
+
+	ret = kstrtouint(buf, 0, &value);
+	if (ret != 0)
+		return ret;
+
+	clamped = min_t(u32, value, SIMTEMP_HYSTERESIS_MC_MAX);
+	if (clamped != value)
+		dev_warn(sim->dev, "hysteresis clamped to %u mC (was %u)\n",
+			 clamped, value);
+
+	mutex_lock(&sim->lock);
+	cfg = sim->cfg;
+	cfg.hysteresis_mc = clamped;
+	simtemp_cfg_apply(sim, &cfg);
+	mutex_unlock(&sim->lock);
+
+	return count;
+}
+static DEVICE_ATTR_RW(hysteresis_mC);
+static ssize_t mode_show(struct device *dev,
+			struct device_attribute *attr, char *buf)
+{
+	struct simtemp_device *sim;
+	enum simtemp_mode mode;
+
+	sim = simtemp_from_classdev(dev);
+	if (sim == NULL)
+		return -ENODEV;
+
+	mutex_lock(&sim->lock);
+	mode = sim->cfg.mode;
+	if (mode >= SIMTEMP_MODE_MAX)
+		mode = SIMTEMP_MODE_NORMAL;
+	mutex_unlock(&sim->lock);
+
+	return sysfs_emit(buf, "%s\n", simtemp_mode_names[mode]);
+}
+
+static ssize_t mode_store(struct device *dev,
+			 struct device_attribute *attr,
+			 const char *buf, size_t count)
+{
+	struct simtemp_device *sim;
+	struct simtemp_config cfg;
+	enum simtemp_mode mode;
+
+	sim = simtemp_from_classdev(dev);
+	if (sim == NULL)
+		return -ENODEV;
+
+	mode = simtemp_mode_from_string(buf);
+	if (mode >= SIMTEMP_MODE_MAX) {
+		simtemp_stat_inc(sim, SIMTEMP_STAT_ERRORS);
+		dev_warn(sim->dev, "invalid mode request: %.*s\n", (int)count, buf);
+		return -EINVAL;
+	}
+
+	mutex_lock(&sim->lock);
+	if (mode == SIMTEMP_MODE_REPLAY && !sim->replay_len) {
+		mutex_unlock(&sim->lock);
+		dev_warn(sim->dev, "replay mode needs a trace in replay_trace\n");
+		return -ENOENT;
+	}
+	cfg = sim->cfg;
+	cfg.mode = mode;
+	simtemp_cfg_apply(sim, &cfg);
+	mutex_unlock(&sim->lock);
+
+	return count;
+}
+static DEVICE_ATTR_RW(mode);
+
+static ssize_t replay_trace_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	struct simtemp_device *sim = simtemp_from_classdev(dev);
+	ssize_t len;
+
+	if (sim == NULL)
+		return -ENODEV;
+
+	mutex_lock(&sim->lock);
+	if (sim->replay_len)
+		len = sysfs_emit(buf, "%s %u\n", sim->replay_name,
+				 sim->replay_len);
+	else
+		len = sysfs_emit(buf, "\n");
+	mutex_unlock(&sim->lock);
+
+	return len;
+}
+
+/*
+ * Writing a firmware file name loads it as the replay trace; writing an
+ * empty line drops the trace, which is refused while replay mode uses it.
+ */
+static ssize_t replay_trace_store(struct device *dev,
+				  struct device_attribute *attr,
+				  const char *buf, size_t count)
+{
+	struct simtemp_device *sim = simtemp_from_classdev(dev);
+	char name[sizeof(sim->replay_name)];
+	s32 *trace = NULL;
+	u32 len = 0U;
+	int ret;
+
+	if (sim == NULL)
+		return -ENODEV;
+
+	if (count >= sizeof(name))
+		return -ENAMETOOLONG;
+	strscpy(name, buf, sizeof(name));
+	strim(name);
+
+	/* Firmware loading may sleep for a while; keep it outside the lock. */
+	if (name[0]) {
+		ret = simtemp_replay_load(sim, name, &trace, &len);
+		if (ret) {
+			simtemp_stat_inc(sim, SIMTEMP_STAT_ERRORS);
+			return ret;
+		}
+	}
+
+	mutex_lock(&sim->lock);
+	if (!trace && sim->cfg.mode == SIMTEMP_MODE_REPLAY) {
+		mutex_unlock(&sim->lock);
+		return -EBUSY;
+	}
+	simtemp_replay_install(sim, trace, len, name);
+	mutex_unlock(&sim->lock);
+
+	return count;
+}
+static DEVICE_ATTR_RW(replay_trace);
+
+static ssize_t replay_loop_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct simtemp_device *sim = simtemp_from_classdev(dev);
+	u32 loop;
+
+	if (sim == NULL)
+		return -ENODEV;
+
+	mutex_lock(&sim->lock);
+	loop = sim->cfg.replay_loop;
+	mutex_unlock(&sim->lock);
+
+	return sysfs_emit(buf, "%u\n", loop);
+}
+
+static ssize_t replay_loop_store(struct device *dev,
+				 struct device_attribute *attr,
+				 const char *buf, size_t count)
+{
+	struct simtemp_device *sim = simtemp_from_classdev(dev);
+	struct simtemp_config cfg;
+	bool loop;
+	int ret;
+
+	if (sim == NULL)
+		return -ENODEV;
+
+	ret = kstrtobool(buf, &loop);
+	if (ret != 0)
+		return ret;
+
+	mutex_lock(&sim->lock);
+	cfg = sim->cfg;
+	cfg.replay_loop = loop;
+	simtemp_cfg_apply(sim, &cfg);
+	mutex_unlock(&sim->lock);
+
+	return count;
+}
+static DEVICE_ATTR_RW(replay_loop);
+
+static ssize_t wave_amplitude_mC_show(struct device *dev,
+				     struct device_attribute *attr, char *buf)
+{
+	struct simtemp_device *sim = simtemp_from_classdev(dev);
+	u32 value;
+
+	if (sim == NULL)
+		return -ENODEV;
+
+	mutex_lock(&sim->lock);
+	value = sim->cfg.wave_amplitude_mc;
+	mutex_unlock(&sim->lock);
+
+	return sysfs_emit(buf, "%u\n", value);
+}
+
+static ssize_t wave_amplitude_mC_store(struct device *dev,
+				      struct device_attribute *attr,
+				      const char *buf, size_t count)
+{
+	struct simtemp_device *sim = simtemp_from_classdev(dev);
+	struct simtemp_config cfg;
+	u32 value;
+	u32 clamped;
+	int ret;
+
+	if (sim == NULL)
+		return -ENODEV;
+
+	ret = kstrtouint(buf, 0, &value);
+	if (ret != 0)
+		return ret;
+
+	clamped = clamp_t(u32, value, 0U, SIMTEMP_WAVE_AMPLITUDE_MAX);
+	if (clamped != value)
+		dev_warn(sim->dev, "wave_amplitude clamped to %u mC (was %u)\n",
+			 clamped, value);
+
+	mutex_lock(&sim->lock);
+	cfg = sim->cfg;
+	cfg.wave_amplitude_mc = clamped;
+	simtemp_cfg_apply(sim, &cfg);
+	mutex_unlock(&sim->lock);
+
+	return count;
+}
+static DEVICE_ATTR_RW(wave_amplitude_mC);
+
+static ssize_t wave_offset_mC_show(struct device *dev,
+				  struct device_attribute *attr, char *buf)
+{
+	struct simtemp_device *sim = simtemp_from_classdev(dev);
+	s32 value;
+
+	if (sim == NULL)
+		return -ENODEV;
+
+	mutex_lock(&sim->lock);
+	value = sim->cfg.wave_offset_mc;
+	mutex_unlock(&sim->lock);
+
+	return sysfs_emit(buf, "%d\n", value);
+}
+
+static ssize_t wave_offset_mC_store(struct device *dev,
+				   struct device_attribute *attr,
+				   const char *buf, size_t count)
+{
+	struct simtemp_device *sim = simtemp_from_classdev(dev);
+	struct simtemp_config cfg;
+	s32 value;
+	s32 clamped;
+	int ret;
+
+	if (sim == NULL)
+		return -ENODEV;
+
+	ret = kstrtoint(buf, 0, &value);
+	if (ret != 0)
+		return ret;
+
+	clamped = clamp_t(s32, value, SIMTEMP_WAVE_OFFSET_MIN, SIMTEMP_WAVE_OFFSET_MAX);
+	if (clamped != value)
+		dev_warn(sim->dev, "wave_offset clamped to %d mC (was %d)\n",
+			 clamped, value);
+
+	mutex_lock(&sim->lock);
+	cfg = sim->cfg;
+	cfg.wave_offset_mc = clamped;
+	simtemp_cfg_apply(sim, &cfg);
+	mutex_unlock(&sim->lock);
+
+	return count;
+}
+static DEVICE_ATTR_RW(wave_offset_mC);
+
+static ssize_t wave_period_show(struct device *dev,
+			       struct device_attribute *attr, char *buf)
+{
+	struct simtemp_device *sim = simtemp_from_classdev(dev);
+	u32 value;
+
+	if (sim == NULL)
+		return -ENODEV;
+
+	mutex_lock(&sim->lock);
+	value = sim->cfg.wave_period;
+	mutex_unlock(&sim->lock);
+
+	return sysfs_emit(buf, "%u\n", value);
+}
+
+static ssize_t wave_period_store(struct device *dev,
+				struct device_attribute *attr,
+				const char *buf, size_t count)
+{
+	struct simtemp_device *sim = simtemp_from_classdev(dev);
+	struct simtemp_config cfg;
+	u32 value;
+	u32 clamped;
+	int ret;
+
+	if (sim == NULL)
+		return -ENODEV;
+
+	ret = kstrtouint(buf, 0, &value);
+	if (ret != 0)
+		return ret;
 
-static bool force_create_dev;
-module_param(force_create_dev, bool, 0444);
-MODULE_PARM_DESC(force_create_dev,
-		"Create a temporary platform_device on load (for x86 dev)");
+	clamped = clamp_t(u32, value, SIMTEMP_WAVE_PERIOD_MIN, SIMTEMP_WAVE_PERIOD_MAX);
+	if (clamped != value)
+		dev_warn(sim->dev, "wave_period clamped to %u (was %u)\n",
+			 clamped, value);
 
-static DEFINE_IDA(simtemp_ida);
-static struct class *simtemp_class;
-static struct platform_device *simtemp_pdev;
+	mutex_lock(&sim->lock);
+	cfg = sim->cfg;
+	cfg.wave_period = clamped;
+	simtemp_cfg_apply(sim, &cfg);
+	mutex_unlock(&sim->lock);
 
-static struct simtemp_device *simtemp_from_classdev(struct device *dev)
-{
-	return dev_get_drvdata(dev);
+	return count;
 }
+static DEVICE_ATTR_RW(wave_period);
 
-static inline struct simtemp_device *simtemp_from_timer(struct timer_list *timer)
+static enum simtemp_overflow_policy simtemp_overflow_from_string(const char *str)
 {
-	return (struct simtemp_device *)((char *)timer - offsetof(struct simtemp_device, sample_timer));
-}
+	int i;
 
-static inline struct simtemp_device *simtemp_from_misc(struct miscdevice *misc)
-{
-	return (struct simtemp_device *)((char *)misc - offsetof(struct simtemp_device, miscdev));
-}
+	for (i = 0; i < SIMTEMP_OVERFLOW_MAX; i++) {
+		if (sysfs_streq(str, simtemp_overflow_names[i]))
+			return i;
+	}
 
-static bool simtemp_buffer_has_data(const struct simtemp_device *sim)
-{
-	return READ_ONCE(sim->ring_count) > 0U;
+	return SIMTEMP_OVERFLOW_MAX;
 }
 
-static unsigned long simtemp_delay_jiffies(const struct simtemp_device *sim)
+static ssize_t overflow_policy_show(struct device *dev,
+				    struct device_attribute *attr, char *buf)
 {
-	unsigned int ms = DIV_ROUND_UP(READ_ONCE(sim->sampling_us), 1000U);
-	unsigned long delay = msecs_to_jiffies(ms);
-	return delay ? delay : 1UL;
+	struct simtemp_device *sim;
+	enum simtemp_overflow_policy policy;
+
+	sim = simtemp_from_classdev(dev);
+	if (sim == NULL)
+		return -ENODEV;
+
+	mutex_lock(&sim->lock);
+	policy = sim->cfg.overflow_policy;
+	mutex_unlock(&sim->lock);
+
+	return sysfs_emit(buf, "%s\n", simtemp_overflow_names[policy]);
 }
 
-static void simtemp_restart_timer(struct simtemp_device *sim)
+static ssize_t overflow_policy_store(struct device *dev,
+				     struct device_attribute *attr,
+				     const char *buf, size_t count)
 {
-	if (READ_ONCE(sim->stopping))
-		return;
+	struct simtemp_device *sim;
+	struct simtemp_config cfg;
+	enum simtemp_overflow_policy policy;
 
-	if (READ_ONCE(sim->use_thread)) {
-		struct task_struct *task = READ_ONCE(sim->sample_task);
-		if (task)
-			wake_up_process(task);
-		return;
+	sim = simtemp_from_classdev(dev);
+	if (sim == NULL)
+		return -ENODEV;
+
+	policy = simtemp_overflow_from_string(buf);
+	if (policy >= SIMTEMP_OVERFLOW_MAX) {
+		simtemp_stat_inc(sim, SIMTEMP_STAT_ERRORS);
+		dev_warn(sim->dev, "invalid overflow_policy request: %.*s\n",
+			 (int)count, buf);
+		return -EINVAL;
 	}
 
-	mod_timer(&sim->sample_timer, jiffies + simtemp_delay_jiffies(sim));
-}
+	mutex_lock(&sim->lock);
+	cfg = sim->cfg;
+	cfg.overflow_policy = policy;
+	simtemp_cfg_apply(sim, &cfg);
+	mutex_unlock(&sim->lock);
 
-static void simtemp_set_mode(struct simtemp_device *sim, enum simtemp_mode mode)
-{
-	WRITE_ONCE(sim->mode, mode);
-	WRITE_ONCE(sim->ramp_increasing, true);
-	if (mode == SIMTEMP_MODE_RAMP)
-		WRITE_ONCE(sim->last_temp_mc, SIMTEMP_TEMP_MIN_MC);
+	return count;
 }
+static DEVICE_ATTR_RW(overflow_policy);
 
-static enum simtemp_mode simtemp_mode_from_string(const char *str)
+static enum simtemp_clock simtemp_clock_from_string(const char *str)
 {
 	int i;
 
-	for (i = 0; i < SIMTEMP_MODE_MAX; i++) {
-		if (sysfs_streq(str, simtemp_mode_names[i]))
+	for (i = 0; i < SIMTEMP_CLOCK_MAX; i++) {
+		if (sysfs_streq(str, simtemp_clock_names[i]))
 			return i;
 	}
 
-	return SIMTEMP_MODE_MAX;
+	return SIMTEMP_CLOCK_MAX;
 }
 
-static s32 simtemp_generate_temp(struct simtemp_device *sim)
+static ssize_t timestamp_clock_show(struct device *dev,
+				    struct device_attribute *attr, char *buf)
 {
-	enum simtemp_mode mode = READ_ONCE(sim->mode);
-	s32 temp = READ_ONCE(sim->last_temp_mc);
-
-	switch (mode) {
-	case SIMTEMP_MODE_NORMAL: {
-		s32 delta = (s32)(get_random_u32() % (2 * SIMTEMP_TEMP_STEP_MC + 1)) -
-			 SIMTEMP_TEMP_STEP_MC;
-		temp += delta;
-		break;
-	}
-	case SIMTEMP_MODE_NOISY: {
-		s32 delta = (s32)(get_random_u32() % (6 * SIMTEMP_TEMP_STEP_MC + 1)) -
-			 (3 * SIMTEMP_TEMP_STEP_MC);
-		temp += delta;
-		break;
-	}
-	case SIMTEMP_MODE_RAMP:
-	default: {
-		bool ramp_up = READ_ONCE(sim->ramp_increasing);
+	struct simtemp_device *sim;
+	enum simtemp_clock clock;
 
-		if (ramp_up)
-			temp += SIMTEMP_TEMP_STEP_MC;
-		else
-			temp -= SIMTEMP_TEMP_STEP_MC;
-		if (temp >= SIMTEMP_TEMP_MAX_MC) {
-			temp = SIMTEMP_TEMP_MAX_MC;
-			ramp_up = false;
-		} else if (temp <= SIMTEMP_TEMP_MIN_MC) {
-			temp = SIMTEMP_TEMP_MIN_MC;
-			ramp_up = true;
-		}
-		WRITE_ONCE(sim->ramp_increasing, ramp_up);
-		break;
-	}
-	}
+	sim = simtemp_from_classdev(dev);
+	if (sim == NULL)
+		return -ENODEV;
 
-	temp = clamp_t(s32, temp, SIMTEMP_TEMP_MIN_MC, SIMTEMP_TEMP_MAX_MC);
-	WRITE_ONCE(sim->last_temp_mc, temp);
+	mutex_lock(&sim->lock);
+	clock = sim->cfg.clock;
+	mutex_unlock(&sim->lock);
 
-	return temp;
+	return sysfs_emit(buf, "%s\n", simtemp_clock_names[clock]);
 }
 
-static void simtemp_push_sample(struct simtemp_device *sim,
-					const struct simtemp_sample *sample)
+static ssize_t timestamp_clock_store(struct device *dev,
+				     struct device_attribute *attr,
+				     const char *buf, size_t count)
 {
-	unsigned long flags;
-
-	spin_lock_irqsave(&sim->buf_lock, flags);
-	if (sim->ring_count == SIMTEMP_RING_DEPTH) {
-		const struct simtemp_sample *old = &sim->ring[sim->tail];
-		if ((old->flags & SIMTEMP_SAMPLE_FLAG_THRESHOLD_ALERT) &&
-		    sim->alert_count > 0U)
-			sim->alert_count--;
-		sim->tail = (sim->tail + 1U) % SIMTEMP_RING_DEPTH;
-	} else {
-		sim->ring_count++;
-	}
-
-	sim->ring[sim->head] = *sample;
-	sim->head = (sim->head + 1U) % SIMTEMP_RING_DEPTH;
+	struct simtemp_device *sim;
+	struct simtemp_config cfg;
+	enum simtemp_clock clock;
 
-	sim->updates++;
+	sim = simtemp_from_classdev(dev);
+	if (sim == NULL)
+		return -ENODEV;
 
-	sim->pending_events |= SIMTEMP_EVENT_SAMPLE;
-	if (sample->flags & SIMTEMP_SAMPLE_FLAG_THRESHOLD_ALERT) {
-		sim->alert_count++;
-		sim->alerts++;
-		sim->pending_events |= SIMTEMP_EVENT_THRESHOLD;
+	clock = simtemp_clock_from_string(buf);
+	if (clock >= SIMTEMP_CLOCK_MAX) {
+		simtemp_stat_inc(sim, SIMTEMP_STAT_ERRORS);
+		dev_warn(sim->dev, "invalid timestamp_clock request: %.*s\n",
+			 (int)count, buf);
+		return -EINVAL;
 	}
 
-	spin_unlock_irqrestore(&sim->buf_lock, flags);
-	wake_up_interruptible(&sim->waitq);
+	mutex_lock(&sim->lock);
+	cfg = sim->cfg;
+	cfg.clock = clock;
+	simtemp_cfg_apply(sim, &cfg);
+	mutex_unlock(&sim->lock);
+
+	return count;
 }
+static DEVICE_ATTR_RW(timestamp_clock);
 
-static void simtemp_produce_sample(struct simtemp_device *sim)
+static ssize_t lowat_show(struct device *dev,
+			  struct device_attribute *attr, char *buf)
 {
-	struct simtemp_sample sample = { 0 };
-	s32 temp;
+	struct simtemp_device *sim = simtemp_from_classdev(dev);
+	u32 lowat;
+
+	if (sim == NULL)
+		return -ENODEV;
 
-	temp = simtemp_generate_temp(sim);
-	sample.timestamp_ns = ktime_get_real_ns();
-	sample.temp_mc = temp;
-	sample.flags = SIMTEMP_SAMPLE_FLAG_NEW_SAMPLE;
-	if (temp >= READ_ONCE(sim->threshold_mc))
-		sample.flags |= SIMTEMP_SAMPLE_FLAG_THRESHOLD_ALERT;
+	mutex_lock(&sim->lock);
+	lowat = sim->cfg.lowat;
+	mutex_unlock(&sim->lock);
 
-	simtemp_push_sample(sim, &sample);
+	return sysfs_emit(buf, "%u\n", lowat);
 }
 
-static void simtemp_timer_cb(struct timer_list *t)
+static ssize_t lowat_store(struct device *dev,
+			   struct device_attribute *attr,
+			   const char *buf, size_t count)
 {
-	struct simtemp_device *sim = simtemp_from_timer(t);
+	struct simtemp_device *sim = simtemp_from_classdev(dev);
+	struct simtemp_config cfg;
+	u32 value;
+	int ret;
 
-	simtemp_produce_sample(sim);
+	if (sim == NULL)
+		return -ENODEV;
 
-	if (!READ_ONCE(sim->stopping))
-		simtemp_restart_timer(sim);
+	ret = kstrtouint(buf, 0, &value);
+	if (ret != 0)
+		return ret;
+
+	if (value == 0U) {
+		dev_warn(sim->dev, "lowat clamped to 1 (was 0)\n");
+		value = 1U;
+	}
+
+	mutex_lock(&sim->lock);
+	cfg = sim->cfg;
+	cfg.lowat = value;
+	simtemp_cfg_apply(sim, &cfg);
+	mutex_unlock(&sim->lock);
+
+	return count;
 }
+static DEVICE_ATTR_RW(lowat);
 
-#if IS_ENABLED(CONFIG_HIGH_RES_TIMERS)
-static void simtemp_worker_sleep(u32 us)
+static ssize_t max_latency_us_show(struct device *dev,
+				   struct device_attribute *attr, char *buf)
 {
-	if (us >= 1000U) {
-		msleep_interruptible(us / 1000U);
-	} else {
-		u32 slack = max_t(u32, 50U, us / 4U);
-		usleep_range(us, us + slack);
-	}
+	struct simtemp_device *sim = simtemp_from_classdev(dev);
+	u32 latency;
+
+	if (sim == NULL)
+		return -ENODEV;
+
+	mutex_lock(&sim->lock);
+	latency = sim->cfg.max_latency_us;
+	mutex_unlock(&sim->lock);
+
+	return sysfs_emit(buf, "%u\n", latency);
 }
 
-static int simtemp_worker_thread(void *data)
+static ssize_t max_latency_us_store(struct device *dev,
+				    struct device_attribute *attr,
+				    const char *buf, size_t count)
 {
-	struct simtemp_device *sim = data;
+	struct simtemp_device *sim = simtemp_from_classdev(dev);
+	struct simtemp_config cfg;
+	u32 value;
+	u32 clamped;
+	int ret;
 
-	while (!kthread_should_stop()) {
-		if (READ_ONCE(sim->stopping))
-			break;
+	if (sim == NULL)
+		return -ENODEV;
 
-		simtemp_produce_sample(sim);
+	ret = kstrtouint(buf, 0, &value);
+	if (ret != 0)
+		return ret;
 
-		if (READ_ONCE(sim->stopping))
-			break;
+	clamped = min_t(u32, value, SIMTEMP_MAX_LATENCY_US_MAX);
+	if (clamped != value)
+		dev_warn(sim->dev, "max_latency_us clamped to %u us (was %u)\n",
+			 clamped, value);
 
-		simtemp_worker_sleep(max_t(u32,
-					    READ_ONCE(sim->sampling_us),
-					    SIMTEMP_SAMPLING_US_MIN));
-	}
+	mutex_lock(&sim->lock);
+	cfg = sim->cfg;
+	cfg.max_latency_us = clamped;
+	simtemp_cfg_apply(sim, &cfg);
+	mutex_unlock(&sim->lock);
 
-	return 0;
+	return count;
 }
-#endif
-
-#if IS_ENABLED(CONFIG_HIGH_RES_TIMERS)
-#endif
+static DEVICE_ATTR_RW(max_latency_us);
 
-static ssize_t sampling_ms_show(struct device *dev,
-					struct device_attribute *attr, char *buf)
+static ssize_t burst_show(struct device *dev,
+			  struct device_attribute *attr, char *buf)
 {
-	struct simtemp_device *sim;
-	u32 sampling;
+	struct simtemp_device *sim = simtemp_from_classdev(dev);
+	u32 burst;
 
-	sim = simtemp_from_classdev(dev);
 	if (sim == NULL)
 		return -ENODEV;
 
 	mutex_lock(&sim->lock);
-	sampling = DIV_ROUND_CLOSEST(sim->sampling_us, 1000U);
+	burst = sim->cfg.burst;
 	mutex_unlock(&sim->lock);
 
-	return sysfs_emit(buf, "%u\n", sampling);
+	return sysfs_emit(buf, "%u\n", burst);
 }
 
-static ssize_t sampling_ms_store(struct device *dev,
-				struct device_attribute *attr,
-				 const char *buf, size_t count)
+static ssize_t burst_store(struct device *dev,
+			   struct device_attribute *attr,
+			   const char *buf, size_t count)
 {
-	struct simtemp_device *sim;
-	unsigned int value;
-	unsigned int clamped;
+	struct simtemp_device *sim = simtemp_from_classdev(dev);
+	struct simtemp_config cfg;
+	u32 value;
+	u32 clamped;
 	int ret;
 
-	sim = simtemp_from_classdev(dev);
 	if (sim == NULL)
 		return -ENODEV;
 
@@ -281,44 +1971,43 @@ static ssize_t sampling_ms_store(struct device *dev,
 	if (ret != 0)
 		return ret;
 
-	clamped = clamp_t(unsigned int, value,
-			 SIMTEMP_SAMPLING_MS_MIN, SIMTEMP_SAMPLING_MS_MAX);
-
-	mutex_lock(&sim->lock);
+	clamped = clamp_t(u32, value, 1U, SIMTEMP_BURST_MAX);
 	if (clamped != value)
-		dev_warn(sim->dev,
-			 "sampling_ms clamped to %u ms (was %u)\n",
+		dev_warn(sim->dev, "burst clamped to %u (was %u)\n",
 			 clamped, value);
-	sim->sampling_us = clamped * 1000U;
-	mutex_unlock(&sim->lock);
 
-	simtemp_restart_timer(sim);
+	mutex_lock(&sim->lock);
+	cfg = sim->cfg;
+	cfg.burst = clamped;
+	simtemp_cfg_apply(sim, &cfg);
+	mutex_unlock(&sim->lock);
 
 	return count;
 }
-static DEVICE_ATTR_RW(sampling_ms);
+static DEVICE_ATTR_RW(burst);
 
-static ssize_t sampling_us_show(struct device *dev,
-				 struct device_attribute *attr, char *buf)
+static ssize_t agg_window_show(struct device *dev,
+			       struct device_attribute *attr, char *buf)
 {
 	struct simtemp_device *sim = simtemp_from_classdev(dev);
-	u32 sampling;
+	u32 window;
 
 	if (sim == NULL)
 		return -ENODEV;
 
 	mutex_lock(&sim->lock);
-	sampling = sim->sampling_us;
+	window = sim->cfg.agg_window;
 	mutex_unlock(&sim->lock);
 
-	return sysfs_emit(buf, "%u\n", sampling);
+	return sysfs_emit(buf, "%u\n", window);
 }
 
-static ssize_t sampling_us_store(struct device *dev,
-				 struct device_attribute *attr,
-				 const char *buf, size_t count)
+static ssize_t agg_window_store(struct device *dev,
+				struct device_attribute *attr,
+				const char *buf, size_t count)
 {
 	struct simtemp_device *sim = simtemp_from_classdev(dev);
+	struct simtemp_config cfg;
 	u32 value;
 	u32 clamped;
 	int ret;
@@ -330,141 +2019,132 @@ static ssize_t sampling_us_store(struct device *dev,
 	if (ret != 0)
 		return ret;
 
-	clamped = clamp_t(u32, value,
-			 SIMTEMP_SAMPLING_US_MIN, SIMTEMP_SAMPLING_US_MAX);
-
+	clamped = min_t(u32, value, SIMTEMP_AGG_WINDOW_MAX);
 	if (clamped != value)
-		dev_warn(sim->dev,
-			 "sampling_us clamped to %u us (was %u)\n",
+		dev_warn(sim->dev, "agg_window clamped to %u (was %u)\n",
 			 clamped, value);
 
-	if (!READ_ONCE(sim->use_thread) && clamped < 1000U) {
-		dev_warn(sim->dev,
-			 "sampling_us=%u us requested but high-res timers unavailable; rounding up to 1000 us\n",
-			 clamped);
-		clamped = 1000U;
-	}
-
 	mutex_lock(&sim->lock);
-	sim->sampling_us = clamped;
+	cfg = sim->cfg;
+	cfg.agg_window = clamped;
+	simtemp_cfg_apply(sim, &cfg);
 	mutex_unlock(&sim->lock);
 
-	simtemp_restart_timer(sim);
-
 	return count;
 }
-static DEVICE_ATTR_RW(sampling_us);
+static DEVICE_ATTR_RW(agg_window);
 
-static ssize_t threshold_mC_show(struct device *dev,
-				struct device_attribute *attr, char *buf)
+static ssize_t seed_show(struct device *dev,
+			 struct device_attribute *attr, char *buf)
 {
-	struct simtemp_device *sim;
-	s32 threshold;
+	struct simtemp_device *sim = simtemp_from_classdev(dev);
+	u64 seed;
 
-	sim = simtemp_from_classdev(dev);
 	if (sim == NULL)
 		return -ENODEV;
 
 	mutex_lock(&sim->lock);
-	threshold = sim->threshold_mc;
+	seed = sim->cfg.seed;
 	mutex_unlock(&sim->lock);
 
-	return sysfs_emit(buf, "%d\n", threshold);
+	return sysfs_emit(buf, "%llu\n", seed);
 }
 
-static ssize_t threshold_mC_store(struct device *dev,
-				struct device_attribute *attr,
-				 const char *buf, size_t count)
+static ssize_t seed_store(struct device *dev,
+			  struct device_attribute *attr,
+			  const char *buf, size_t count)
 {
-	struct simtemp_device *sim;
-	int value;
+	struct simtemp_device *sim = simtemp_from_classdev(dev);
+	struct simtemp_config cfg;
+	u64 value;
 	int ret;
 
-	sim = simtemp_from_classdev(dev);
 	if (sim == NULL)
 		return -ENODEV;
 
-	ret = kstrtoint(buf, 0, &value);
+	ret = kstrtou64(buf, 0, &value);
 	if (ret != 0)
 		return ret;
 
 	mutex_lock(&sim->lock);
-	sim->threshold_mc = value;
+	cfg = sim->cfg;
+	cfg.seed = value;
+	/* Writing the current seed again restarts the waveform as well. */
+	if (value == sim->cfg.seed)
+		simtemp_reseed(sim);
+	else
+		simtemp_cfg_apply(sim, &cfg);
 	mutex_unlock(&sim->lock);
 
 	return count;
 }
-static DEVICE_ATTR_RW(threshold_mC);
-static ssize_t mode_show(struct device *dev,
-			struct device_attribute *attr, char *buf)
+static DEVICE_ATTR_RW(seed);
+
+static ssize_t stats_show(struct device *dev,
+			 struct device_attribute *attr, char *buf)
 {
 	struct simtemp_device *sim;
-	enum simtemp_mode mode;
+	u64 totals[SIMTEMP_STAT_MAX];
+	int len = 0;
+	int i;
 
 	sim = simtemp_from_classdev(dev);
 	if (sim == NULL)
 		return -ENODEV;
 
-	mutex_lock(&sim->lock);
-	mode = sim->mode;
-	if (mode >= SIMTEMP_MODE_MAX)
-		mode = SIMTEMP_MODE_NORMAL;
-	mutex_unlock(&sim->lock);
+	simtemp_stats_sum(sim, totals);
 
-	return sysfs_emit(buf, "%s\n", simtemp_mode_names[mode]);
+	for (i = 0; i < SIMTEMP_STAT_MAX; i++)
+		len += sysfs_emit_at(buf, len, "%s%s=%llu", i ? " " : "",
+				     simtemp_stat_names[i], totals[i]);
+	len += sysfs_emit_at(buf, len, "\n");
+
+	return len;
 }
+static DEVICE_ATTR_RO(stats);
 
-static ssize_t mode_store(struct device *dev,
-			 struct device_attribute *attr,
-			 const char *buf, size_t count)
+static ssize_t ring_depth_show(struct device *dev,
+			       struct device_attribute *attr, char *buf)
 {
-	struct simtemp_device *sim;
-	enum simtemp_mode mode;
+	struct simtemp_device *sim = simtemp_from_classdev(dev);
+	u32 depth;
 
-	sim = simtemp_from_classdev(dev);
 	if (sim == NULL)
 		return -ENODEV;
 
-	mode = simtemp_mode_from_string(buf);
-	if (mode >= SIMTEMP_MODE_MAX) {
-		unsigned long flags;
-
-		spin_lock_irqsave(&sim->buf_lock, flags);
-		sim->errors++;
-		spin_unlock_irqrestore(&sim->buf_lock, flags);
-		dev_warn(sim->dev, "invalid mode request: %.*s\n", (int)count, buf);
-		return -EINVAL;
-	}
-
 	mutex_lock(&sim->lock);
-	simtemp_set_mode(sim, mode);
+	depth = sim->ring_depth;
 	mutex_unlock(&sim->lock);
 
-	return count;
+	return sysfs_emit(buf, "%u\n", depth);
 }
-static DEVICE_ATTR_RW(mode);
 
-static ssize_t stats_show(struct device *dev,
-			 struct device_attribute *attr, char *buf)
+static ssize_t ring_depth_store(struct device *dev,
+				struct device_attribute *attr,
+				const char *buf, size_t count)
 {
-	struct simtemp_device *sim;
-	unsigned long flags;
-	u32 updates, alerts, errors;
+	struct simtemp_device *sim = simtemp_from_classdev(dev);
+	u32 value;
+	int ret;
 
-	sim = simtemp_from_classdev(dev);
 	if (sim == NULL)
 		return -ENODEV;
 
-	spin_lock_irqsave(&sim->buf_lock, flags);
-	updates = sim->updates;
-	alerts = sim->alerts;
-	errors = sim->errors;
-	spin_unlock_irqrestore(&sim->buf_lock, flags);
+	ret = kstrtouint(buf, 0, &value);
+	if (ret != 0)
+		return ret;
+
+	value = simtemp_ring_depth_sanitize(sim->dev, value, "ring_depth");
+
+	mutex_lock(&sim->lock);
+	ret = simtemp_ring_resize(sim, value);
+	mutex_unlock(&sim->lock);
+	if (ret == -EBUSY)
+		dev_warn(sim->dev, "ring_depth can only change while the device is closed\n");
 
-	return sysfs_emit(buf, "updates=%u alerts=%u errors=%u\n",
-			 updates, alerts, errors);
+	return ret ? ret : count;
 }
-static DEVICE_ATTR_RO(stats);
+static DEVICE_ATTR_RW(ring_depth);
 
 static void simtemp_parse_dt(struct simtemp_device *sim)
 {
@@ -472,7 +2152,12 @@ static void simtemp_parse_dt(struct simtemp_device *sim)
 	struct device_node *np = dev->of_node;
 	u32 val;
 	const char *mode_str;
+	const char *policy_str;
+	const char *clock_str;
+	const char *replay_str;
 	enum simtemp_mode mode;
+	enum simtemp_overflow_policy policy;
+	enum simtemp_clock clock;
 
 	if (!np)
 		return;
@@ -485,14 +2170,14 @@ static void simtemp_parse_dt(struct simtemp_device *sim)
 			dev_warn(dev, "sampling-us clamped to %u us (was %u)\n",
 				 clamped, val);
 
-	if (!sim->use_thread && clamped < 1000U) {
+		if (!sim->hres && clamped < 1000U) {
 			dev_warn(dev,
 				 "sampling-us=%u us requested but high-res timers unavailable; rounding up to 1000 us\n",
 				 clamped);
 			clamped = 1000U;
 		}
 
-		sim->sampling_us = clamped;
+		sim->cfg.sampling_us = clamped;
 	} else if (!of_property_read_u32(np, "sampling-ms", &val)) {
 		u32 clamped = clamp_t(u32, val,
 				    SIMTEMP_SAMPLING_MS_MIN, SIMTEMP_SAMPLING_MS_MAX);
@@ -500,27 +2185,123 @@ static void simtemp_parse_dt(struct simtemp_device *sim)
 		if (clamped != val)
 			dev_warn(dev, "sampling-ms clamped to %u ms (was %u)\n",
 				 clamped, val);
-		sim->sampling_us = clamped * 1000U;
+		sim->cfg.sampling_us = clamped * 1000U;
 	}
 
 	if (!of_property_read_u32(np, "threshold-mC", &val))
-		sim->threshold_mc = (s32)val;
+		sim->cfg.threshold_mc = (s32)val;
+
+	if (!of_property_read_u32(np, "hysteresis-mC", &val)) {
+		u32 clamped = min_t(u32, val, SIMTEMP_HYSTERESIS_MC_MAX);
+
+		if (clamped != val)
+			dev_warn(dev, "hysteresis-mC clamped to %u mC (was %u)\n",
+				 clamped, val);
+		sim->cfg.hysteresis_mc = clamped;
+	}
+
+	if (!of_property_read_u32(np, "ring-depth", &val))
+		sim->ring_depth = simtemp_ring_depth_sanitize(dev, val,
+							      "ring-depth");
 
 	if (!of_property_read_string(np, "mode", &mode_str)) {
 		mode = simtemp_mode_from_string(mode_str);
 		if (mode >= SIMTEMP_MODE_MAX) {
-			unsigned long flags;
-
-			spin_lock_irqsave(&sim->buf_lock, flags);
-			sim->errors++;
-			spin_unlock_irqrestore(&sim->buf_lock, flags);
+			simtemp_stat_inc(sim, SIMTEMP_STAT_ERRORS);
 			dev_warn(dev, "invalid mode '%s' in DT, defaulting to %s\n",
 				 mode_str, simtemp_mode_names[SIMTEMP_DEFAULT_MODE]);
-			simtemp_set_mode(sim, SIMTEMP_DEFAULT_MODE);
+			sim->cfg.mode = SIMTEMP_DEFAULT_MODE;
+		} else {
+			sim->cfg.mode = mode;
+		}
+	}
+
+	if (!of_property_read_u32(np, "lowat", &val))
+		sim->cfg.lowat = max(val, 1U);
+
+	if (!of_property_read_u32(np, "max-latency-us", &val)) {
+		u32 clamped = min_t(u32, val, SIMTEMP_MAX_LATENCY_US_MAX);
+
+		if (clamped != val)
+			dev_warn(dev, "max-latency-us clamped to %u us (was %u)\n",
+				 clamped, val);
+		sim->cfg.max_latency_us = clamped;
+	}
+
+	if (!of_property_read_u32(np, "burst", &val)) {
+		u32 clamped = clamp_t(u32, val, 1U, SIMTEMP_BURST_MAX);
+
+		if (clamped != val)
+			dev_warn(dev, "burst clamped to %u (was %u)\n",
+				 clamped, val);
+		sim->cfg.burst = clamped;
+	}
+
+	if (!of_property_read_u32(np, "agg-window", &val)) {
+		u32 clamped = min_t(u32, val, SIMTEMP_AGG_WINDOW_MAX);
+
+		if (clamped != val)
+			dev_warn(dev, "agg-window clamped to %u (was %u)\n",
+				 clamped, val);
+		sim->cfg.agg_window = clamped;
+	}
+
+	if (!of_property_read_string(np, "overflow-policy", &policy_str)) {
+		policy = simtemp_overflow_from_string(policy_str);
+		if (policy >= SIMTEMP_OVERFLOW_MAX) {
+			simtemp_stat_inc(sim, SIMTEMP_STAT_ERRORS);
+			dev_warn(dev, "invalid overflow-policy '%s' in DT, defaulting to %s\n",
+				 policy_str,
+				 simtemp_overflow_names[SIMTEMP_DEFAULT_OVERFLOW]);
+			policy = SIMTEMP_DEFAULT_OVERFLOW;
+		}
+		sim->cfg.overflow_policy = policy;
+	}
+
+	if (!of_property_read_string(np, "replay-firmware", &replay_str)) {
+		if (simtemp_replay_load(sim, replay_str, &sim->replay,
+					&sim->replay_len)) {
+			simtemp_stat_inc(sim, SIMTEMP_STAT_ERRORS);
+			dev_warn(dev, "failed to load replay-firmware '%s'\n",
+				 replay_str);
 		} else {
-			simtemp_set_mode(sim, mode);
+			strscpy(sim->replay_name, replay_str,
+				sizeof(sim->replay_name));
 		}
 	}
+	sim->cfg.replay_loop = of_property_read_bool(np, "replay-loop");
+	if (sim->cfg.mode == SIMTEMP_MODE_REPLAY && !sim->replay_len) {
+		dev_warn(dev, "replay mode without a trace, defaulting to %s\n",
+			 simtemp_mode_names[SIMTEMP_DEFAULT_MODE]);
+		sim->cfg.mode = SIMTEMP_DEFAULT_MODE;
+	}
+
+	if (!of_property_read_u32(np, "wave-amplitude-mC", &val))
+		sim->cfg.wave_amplitude_mc = min_t(u32, val,
+						   SIMTEMP_WAVE_AMPLITUDE_MAX);
+	if (!of_property_read_u32(np, "wave-offset-mC", &val))
+		sim->cfg.wave_offset_mc = clamp_t(s32, (s32)val,
+						  SIMTEMP_WAVE_OFFSET_MIN,
+						  SIMTEMP_WAVE_OFFSET_MAX);
+	if (!of_property_read_u32(np, "wave-period", &val))
+		sim->cfg.wave_period = clamp_t(u32, val, SIMTEMP_WAVE_PERIOD_MIN,
+					       SIMTEMP_WAVE_PERIOD_MAX);
+
+	if (of_property_read_u64(np, "seed", &sim->cfg.seed) &&
+	    !of_property_read_u32(np, "seed", &val))
+		sim->cfg.seed = val;
+
+	if (!of_property_read_string(np, "timestamp-clock", &clock_str)) {
+		clock = simtemp_clock_from_string(clock_str);
+		if (clock >= SIMTEMP_CLOCK_MAX) {
+			simtemp_stat_inc(sim, SIMTEMP_STAT_ERRORS);
+			dev_warn(dev, "invalid timestamp-clock '%s' in DT, defaulting to %s\n",
+				 clock_str,
+				 simtemp_clock_names[SIMTEMP_DEFAULT_CLOCK]);
+			clock = SIMTEMP_DEFAULT_CLOCK;
+		}
+		sim->cfg.clock = clock;
+	}
 }
 
 
@@ -528,8 +2309,23 @@ static struct attribute *simtemp_attrs[] = {
 	&dev_attr_sampling_ms.attr,
 	&dev_attr_sampling_us.attr,
 	&dev_attr_threshold_mC.attr,
+	&dev_attr_temp_mC.attr,
+	&dev_attr_hysteresis_mC.attr,
 	&dev_attr_mode.attr,
+	&dev_attr_replay_trace.attr,
+	&dev_attr_replay_loop.attr,
+	&dev_attr_wave_amplitude_mC.attr,
+	&dev_attr_wave_offset_mC.attr,
+	&dev_attr_wave_period.attr,
 	&dev_attr_stats.attr,
+	&dev_attr_ring_depth.attr,
+	&dev_attr_overflow_policy.attr,
+	&dev_attr_lowat.attr,
+	&dev_attr_max_latency_us.attr,
+	&dev_attr_burst.attr,
+	&dev_attr_agg_window.attr,
+	&dev_attr_timestamp_clock.attr,
+	&dev_attr_seed.attr,
 	NULL,
 };
 
@@ -566,7 +2362,202 @@ void simtemp_sysfs_unregister(struct simtemp_device *sim)
 	sim->class_dev = NULL;
 }
 
-static struct simtemp_device *simtemp_from_file(struct file *file)
+#if IS_REACHABLE(CONFIG_HWMON)
+static umode_t simtemp_hwmon_is_visible(const void *data,
+					enum hwmon_sensor_types type,
+					u32 attr, int channel)
+{
+	return 0444;
+}
+
+static int simtemp_hwmon_read(struct device *dev, enum hwmon_sensor_types type,
+			      u32 attr, int channel, long *val)
+{
+	struct simtemp_device *sim = dev_get_drvdata(dev);
+	struct simtemp_sample sample;
+
+	switch (attr) {
+	case hwmon_temp_input:
+		if (!simtemp_latest_read(sim, &sample))
+			return -ENODATA;
+		*val = sample.temp_mc;
+		return 0;
+	case hwmon_temp_max:
+		*val = READ_ONCE(sim->cfg.threshold_mc);
+		return 0;
+	case hwmon_temp_max_alarm:
+		*val = READ_ONCE(sim->alert_active);
+		return 0;
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+static const struct hwmon_ops simtemp_hwmon_ops = {
+	.is_visible = simtemp_hwmon_is_visible,
+	.read = simtemp_hwmon_read,
+};
+
+static const struct hwmon_channel_info * const simtemp_hwmon_info[] = {
+	HWMON_CHANNEL_INFO(temp, HWMON_T_INPUT | HWMON_T_MAX | HWMON_T_MAX_ALARM),
+	NULL
+};
+
+static const struct hwmon_chip_info simtemp_hwmon_chip_info = {
+	.ops = &simtemp_hwmon_ops,
+	.info = simtemp_hwmon_info,
+};
+
+/*
+ * temp1_input for lm-sensors style tools, served from the latest-value
+ * snapshot. Optional: the device works without it.
+ */
+static void simtemp_hwmon_register(struct simtemp_device *sim)
+{
+	struct device *hwmon;
+
+	hwmon = hwmon_device_register_with_info(sim->dev, "simtemp", sim,
+						&simtemp_hwmon_chip_info, NULL);
+	if (IS_ERR(hwmon)) {
+		dev_warn(sim->dev, "hwmon registration failed (%ld)\n",
+			 PTR_ERR(hwmon));
+		return;
+	}
+	sim->hwmon = hwmon;
+}
+
+static void simtemp_hwmon_unregister(struct simtemp_device *sim)
+{
+	if (sim->hwmon != NULL)
+		hwmon_device_unregister(sim->hwmon);
+	sim->hwmon = NULL;
+}
+#else
+static void simtemp_hwmon_register(struct simtemp_device *sim)
+{
+}
+
+static void simtemp_hwmon_unregister(struct simtemp_device *sim)
+{
+}
+#endif
+
+static struct dentry *simtemp_debugfs_root;
+
+static const char * const simtemp_hist_names[SIMTEMP_HIST_MAX] = {
+	[SIMTEMP_HIST_JITTER] = "jitter",
+	[SIMTEMP_HIST_LATENCY] = "latency",
+};
+
+/* Print one histogram as "[lo, hi) count" lines, relative to the last reset. */
+static void simtemp_hist_print(struct seq_file *m, struct simtemp_device *sim,
+			       enum simtemp_hist hist)
+{
+	u64 totals[SIMTEMP_HIST_BUCKETS];
+	u64 samples = 0U;
+	int last = -1;
+	int i;
+
+	simtemp_hist_sum(sim, hist, totals);
+
+	mutex_lock(&sim->lock);
+	for (i = 0; i < SIMTEMP_HIST_BUCKETS; i++) {
+		totals[i] -= sim->hist_base[hist][i];
+		samples += totals[i];
+		if (totals[i])
+			last = i;
+	}
+	mutex_unlock(&sim->lock);
+
+	seq_printf(m, "# %s_ns samples=%llu\n", simtemp_hist_names[hist], samples);
+	for (i = 0; i <= last; i++) {
+		u64 lo = i ? BIT_ULL(i - 1) : 0U;
+
+		if (i == SIMTEMP_HIST_BUCKETS - 1U)
+			seq_printf(m, "[%llu, inf) %llu\n", lo, totals[i]);
+		else
+			seq_printf(m, "[%llu, %llu) %llu\n", lo,
+				   i ? BIT_ULL(i) : 1U, totals[i]);
+	}
+}
+
+static int simtemp_jitter_show(struct seq_file *m, void *unused)
+{
+	simtemp_hist_print(m, m->private, SIMTEMP_HIST_JITTER);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(simtemp_jitter);
+
+static int simtemp_latency_show(struct seq_file *m, void *unused)
+{
+	simtemp_hist_print(m, m->private, SIMTEMP_HIST_LATENCY);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(simtemp_latency);
+
+/*
+ * The per-CPU buckets are never cleared underneath their writers; a reset
+ * snapshots the current totals and later reads report the difference.
+ */
+static ssize_t simtemp_hist_reset_write(struct file *file,
+					const char __user *buf,
+					size_t count, loff_t *ppos)
+{
+	struct simtemp_device *sim = file->private_data;
+	u64 totals[SIMTEMP_HIST_BUCKETS];
+	int hist;
+
+	for (hist = 0; hist < SIMTEMP_HIST_MAX; hist++) {
+		simtemp_hist_sum(sim, hist, totals);
+		mutex_lock(&sim->lock);
+		memcpy(sim->hist_base[hist], totals, sizeof(totals));
+		mutex_unlock(&sim->lock);
+	}
+
+	return count;
+}
+
+static const struct file_operations simtemp_hist_reset_fops = {
+	.owner	= THIS_MODULE,
+	.open	= simple_open,
+	.write	= simtemp_hist_reset_write,
+	.llseek = noop_llseek,
+};
+
+/* debugfs is best effort: failures leave the driver fully functional. */
+static void simtemp_debugfs_register(struct simtemp_device *sim)
+{
+	sim->debugfs = debugfs_create_dir(dev_name(sim->class_dev),
+					  simtemp_debugfs_root);
+	debugfs_create_file("jitter", 0444, sim->debugfs, sim,
+			    &simtemp_jitter_fops);
+	debugfs_create_file("latency", 0444, sim->debugfs, sim,
+			    &simtemp_latency_fops);
+	debugfs_create_file("reset", 0200, sim->debugfs, sim,
+			    &simtemp_hist_reset_fops);
+}
+
+/*
+ * Last reference gone: probe's, dropped at unbind, and one per open file.
+ * Nothing else can reach the device by now, so no locks are taken.
+ */
+static void simtemp_device_release(struct kref *ref)
+{
+	struct simtemp_device *sim = container_of(ref, struct simtemp_device, ref);
+
+	simtemp_ring_free(sim);
+	simtemp_replay_free(sim);
+	free_percpu(sim->stats);
+	mutex_destroy(&sim->lock);
+	kfree(sim);
+}
+
+static void simtemp_put(struct simtemp_device *sim)
+{
+	kref_put(&sim->ref, simtemp_device_release);
+}
+
+static struct simtemp_reader *simtemp_reader_from_file(struct file *file)
 {
 	return file->private_data;
 }
@@ -575,89 +2566,454 @@ static int simtemp_open(struct inode *inode, struct file *file)
 {
 	struct miscdevice *misc = file->private_data;
 	struct simtemp_device *sim = simtemp_from_misc(misc);
+	struct simtemp_reader *reader;
+
+	reader = kzalloc(sizeof(*reader), GFP_KERNEL);
+	if (reader == NULL)
+		return -ENOMEM;
+
+	reader->ctrl = vmalloc_user(PAGE_SIZE);
+	reader->bounce = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (reader->ctrl == NULL || reader->bounce == NULL) {
+		kfree(reader->bounce);
+		vfree(reader->ctrl);
+		kfree(reader);
+		return -ENOMEM;
+	}
+	reader->sim = sim;
+	mutex_init(&reader->read_lock);
+	init_waitqueue_head(&reader->waitq);
+
+	/* New readers start at the live edge rather than replaying history. */
+	mutex_lock(&sim->lock);
+	if (sim->stopping) {
+		mutex_unlock(&sim->lock);
+		mutex_destroy(&reader->read_lock);
+		kfree(reader->bounce);
+		vfree(reader->ctrl);
+		kfree(reader);
+		return -ENODEV;
+	}
+	kref_get(&sim->ref);
+	sim->open_count++;
+	reader->ctrl->tail = smp_load_acquire(&sim->ctrl->head);
+	spin_lock_irq(&sim->alert_lock);
+	reader->alert_tail = sim->alert_head;
+	spin_unlock_irq(&sim->alert_lock);
+	reader->stream = SIMTEMP_STREAM_RAW;
+	spin_lock_irq(&sim->readers_lock);
+	list_add_tail(&reader->node, &sim->readers);
+	spin_unlock_irq(&sim->readers_lock);
+	mutex_unlock(&sim->lock);
 
-	file->private_data = sim;
+	file->private_data = reader;
+	/* read_iter() honours IOCB_NOWAIT, so io_uring may read inline. */
+	file->f_mode |= FMODE_NOWAIT;
 
 	return 0;
 }
 
-static ssize_t simtemp_read(struct file *file, char __user *buf, size_t count,
-			    loff_t *ppos)
+static int simtemp_release(struct inode *inode, struct file *file)
 {
-	struct simtemp_device *sim = simtemp_from_file(file);
-	struct simtemp_sample sample;
-	unsigned long flags;
+	struct simtemp_reader *reader = simtemp_reader_from_file(file);
+	struct simtemp_device *sim = reader->sim;
 
-	if (count < sizeof(sample))
-		return -EINVAL;
+	mutex_lock(&sim->lock);
+	spin_lock_irq(&sim->readers_lock);
+	list_del(&reader->node);
+	spin_unlock_irq(&sim->readers_lock);
+	sim->open_count--;
+	mutex_unlock(&sim->lock);
 
-	if (!(file->f_flags & O_NONBLOCK)) {
-		int ret = wait_event_interruptible(sim->waitq,
-						      sim->stopping || simtemp_buffer_has_data(sim));
-		if (ret)
-			return ret;
-	} else if (!simtemp_buffer_has_data(sim)) {
-		return -EAGAIN;
+	mutex_destroy(&reader->read_lock);
+	kfree(reader->bounce);
+	vfree(reader->ctrl);
+	kfree(reader);
+	simtemp_put(sim);
+
+	return 0;
+}
+
+/*
+ * Copy up to @want records at the reader's cursor into its bounce page
+ * without any lock shared with the producer. The producer may lap us while
+ * we copy, so the claim index is read afterwards and any record it could
+ * have overwritten is dropped and accounted as an overrun.
+ */
+static u32 simtemp_reader_fetch(struct simtemp_reader *reader, u32 want)
+{
+	struct simtemp_device *sim = reader->sim;
+	struct simtemp_sample *batch = reader->bounce;
+	u32 depth = sim->ring_depth;
+	u32 tail = READ_ONCE(reader->ctrl->tail);
+	u32 lost = 0U;
+	u32 head, claim, stale, n;
+
+	for (;;) {
+		head = smp_load_acquire(&sim->ctrl->head);
+		if (head - tail > depth) {
+			/* Lapped: skip to the oldest retained sample. */
+			lost += head - tail - depth;
+			tail = head - depth;
+		}
+		n = min(want, head - tail);
+		if (!n)
+			break;
+
+		simtemp_ring_copy(sim, batch, tail, n);
+
+		smp_rmb();
+		claim = READ_ONCE(sim->ctrl->claim);
+		/* claim is exclusive: only indices below claim - depth are gone. */
+		if (claim - tail <= depth)
+			break;
+
+		stale = claim - depth - tail;
+		if (stale < n) {
+			memmove(batch, batch + stale, (n - stale) * sizeof(*batch));
+			lost += stale;
+			tail += stale;
+			n -= stale;
+			break;
+		}
+		lost += n;
+		tail += n;
 	}
 
-	if (sim->stopping && !simtemp_buffer_has_data(sim))
-		return 0;
+	if (lost) {
+		WRITE_ONCE(reader->ctrl->overruns,
+			   reader->ctrl->overruns + lost);
+		simtemp_stat_add(sim, SIMTEMP_STAT_OVERWRITTEN, lost);
+	}
+	smp_store_release(&reader->ctrl->tail, tail + n);
+	if (n)
+		trace_simtemp_read(sim->id, head, tail + n, n, lost,
+				   &batch[n - 1]);
+
+	return n;
+}
+
+/*
+ * Aggregates are produced at most once per window, so they sit in a small
+ * locked queue instead of a second lock-free ring. A reader more than a
+ * queue behind skips to the oldest retained record.
+ */
+static u32 simtemp_agg_fetch(struct simtemp_reader *reader, u32 want)
+{
+	struct simtemp_device *sim = reader->sim;
+	struct simtemp_aggregate *batch = (struct simtemp_aggregate *)reader->bounce;
+	u32 queued, lost = 0U;
+	u32 i, n;
+
+	spin_lock_irq(&sim->agg_lock);
+	queued = sim->agg_head - reader->agg_tail;
+	if (queued > SIMTEMP_AGG_QUEUE_DEPTH) {
+		lost = queued - SIMTEMP_AGG_QUEUE_DEPTH;
+		queued = SIMTEMP_AGG_QUEUE_DEPTH;
+	}
+	n = min(want, queued);
+	for (i = 0; i < n; i++)
+		batch[i] = sim->aggs[(reader->agg_tail + lost + i) %
+				     SIMTEMP_AGG_QUEUE_DEPTH];
+	WRITE_ONCE(reader->agg_tail, reader->agg_tail + lost + n);
+	spin_unlock_irq(&sim->agg_lock);
+
+	if (lost)
+		simtemp_stat_add(sim, SIMTEMP_STAT_OVERWRITTEN, lost);
+
+	return n;
+}
 
-	spin_lock_irqsave(&sim->buf_lock, flags);
-	if (!sim->ring_count) {
-		spin_unlock_irqrestore(&sim->buf_lock, flags);
-		return sim->stopping ? 0 : -EAGAIN;
-	}
-
-	sample = sim->ring[sim->tail];
-	sim->tail = (sim->tail + 1U) % SIMTEMP_RING_DEPTH;
-	sim->ring_count--;
-	if (sim->ring_count == 0U)
-		sim->pending_events &= ~SIMTEMP_EVENT_SAMPLE;
-	if ((sample.flags & SIMTEMP_SAMPLE_FLAG_THRESHOLD_ALERT) &&
-	    sim->alert_count > 0U) {
-		sim->alert_count--;
-		if (sim->alert_count == 0U)
-			sim->pending_events &= ~SIMTEMP_EVENT_THRESHOLD;
-	}
-	spin_unlock_irqrestore(&sim->buf_lock, flags);
-
-	if (copy_to_user(buf, &sample, sizeof(sample))) {
-		unsigned long err_flags;
-		spin_lock_irqsave(&sim->buf_lock, err_flags);
-		sim->errors++;
-		spin_unlock_irqrestore(&sim->buf_lock, err_flags);
+/*
+ * read(), readv() and io_uring all land here. IOCB_NOWAIT callers (io_uring's
+ * first, inline attempt) never sleep: with nothing queued or the cursor busy
+ * they get -EAGAIN and io_uring arms ->poll to retry once data arrives,
+ * instead of parking a worker thread in wait_event.
+ */
+static ssize_t simtemp_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+	struct file *file = iocb->ki_filp;
+	struct simtemp_reader *reader = simtemp_reader_from_file(file);
+	struct simtemp_device *sim = reader->sim;
+	size_t count = iov_iter_count(to);
+	bool nowait = (iocb->ki_flags & IOCB_NOWAIT) ||
+		      (file->f_flags & O_NONBLOCK);
+	size_t size, bytes;
+	bool aggregate;
+	u32 want, n;
+
+	/*
+	 * Several exclusive waiters can wake for one batch, and the stream can
+	 * be switched while we sleep: a blocking reader that comes away empty
+	 * goes back to sleep rather than returning -EAGAIN.
+	 */
+	for (;;) {
+		aggregate = READ_ONCE(reader->stream) == SIMTEMP_STREAM_AGGREGATE;
+		size = aggregate ? sizeof(struct simtemp_aggregate) :
+				   sizeof(struct simtemp_sample);
+
+		if (count < size)
+			return -EINVAL;
+
+		if (!nowait) {
+			int ret = wait_event_interruptible_exclusive(reader->waitq,
+								     READ_ONCE(sim->stopping) ||
+								     simtemp_reader_ready(reader));
+			if (ret)
+				return ret;
+		}
+
+		/* Unbound: the ring outlives us, but the stream has ended. */
+		if (READ_ONCE(sim->stopping))
+			return -ENODEV;
+		if (nowait && !simtemp_buffer_has_data(reader))
+			return -EAGAIN;
+
+		/*
+		 * Hand out as many whole records as fit in the caller's buffers
+		 * (and the bounce page), validated against the producer and then
+		 * copied out in one go, scattered across the iovecs as needed.
+		 */
+		want = min_t(size_t, count / size,
+			     min_t(size_t, PAGE_SIZE / size, sim->ring_depth));
+
+		if (!nowait)
+			mutex_lock(&reader->read_lock);
+		else if (!mutex_trylock(&reader->read_lock))
+			return -EAGAIN;
+		if (reader->stream != (aggregate ? SIMTEMP_STREAM_AGGREGATE :
+						    SIMTEMP_STREAM_RAW)) {
+			/* Switched streams while we slept; size the new one. */
+			mutex_unlock(&reader->read_lock);
+			continue;
+		}
+		n = aggregate ? simtemp_agg_fetch(reader, want) :
+				simtemp_reader_fetch(reader, want);
+		if (n)
+			break;
+
+		mutex_unlock(&reader->read_lock);
+		if (nowait)
+			return -EAGAIN;
+	}
+
+	if (!aggregate)
+		simtemp_hist_add_latency(sim, reader->bounce, n,
+					 simtemp_now_ns(sim));
+
+	bytes = n * size;
+	if (copy_to_iter(reader->bounce, bytes, to) != bytes) {
+		mutex_unlock(&reader->read_lock);
+		simtemp_stat_inc(sim, SIMTEMP_STAT_ERRORS);
 		return -EFAULT;
 	}
+	mutex_unlock(&reader->read_lock);
+
+	/*
+	 * Exclusive waiters were woken one per batch; if this read left more
+	 * behind than the producer accounted for, pass the baton on.
+	 */
+	if (simtemp_reader_ready(reader) && wq_has_sleeper(&reader->waitq))
+		wake_up_interruptible_nr(&reader->waitq, 1);
+
+	simtemp_stat_inc(sim, SIMTEMP_STAT_READS);
+	simtemp_stat_add(sim, SIMTEMP_STAT_BYTES, bytes);
 
-	return sizeof(sample);
+	return bytes;
 }
 
 static __poll_t simtemp_poll(struct file *file, poll_table *wait)
 {
-	struct simtemp_device *sim = simtemp_from_file(file);
+	struct simtemp_reader *reader = simtemp_reader_from_file(file);
+	struct simtemp_device *sim = reader->sim;
 	__poll_t mask = 0;
-	unsigned long flags;
 
-	poll_wait(file, &sim->waitq, wait);
+	poll_wait(file, &reader->waitq, wait);
+	/* read() and ioctl() fail with -ENODEV from here on. */
+	if (READ_ONCE(sim->stopping))
+		return POLLHUP | POLLERR;
+
+	simtemp_stat_inc(sim, SIMTEMP_STAT_POLLS);
 
-	spin_lock_irqsave(&sim->buf_lock, flags);
-	if (sim->ring_count)
+	if (simtemp_reader_ready(reader))
 		mask |= POLLIN | POLLRDNORM;
-	if (sim->pending_events & SIMTEMP_EVENT_THRESHOLD)
+	if (simtemp_alert_queued(reader))
 		mask |= POLLPRI;
-	if (sim->stopping)
-		mask |= POLLHUP;
-	spin_unlock_irqrestore(&sim->buf_lock, flags);
+
+	trace_simtemp_poll(sim->id, READ_ONCE(sim->ctrl->head),
+			   READ_ONCE(reader->ctrl->tail), (__force unsigned int)mask);
 
 	return mask;
 }
 
+static void simtemp_stats_fill(struct simtemp_device *sim,
+			       struct simtemp_stats *out)
+{
+	u64 totals[SIMTEMP_STAT_MAX];
+
+	simtemp_stats_sum(sim, totals);
+
+	memset(out, 0, sizeof(*out));
+	out->updates = totals[SIMTEMP_STAT_UPDATES];
+	out->alerts = totals[SIMTEMP_STAT_ALERTS];
+	out->errors = totals[SIMTEMP_STAT_ERRORS];
+	out->missed = totals[SIMTEMP_STAT_MISSED];
+	out->overwritten = totals[SIMTEMP_STAT_OVERWRITTEN];
+	out->reads = totals[SIMTEMP_STAT_READS];
+	out->wakeups = totals[SIMTEMP_STAT_WAKEUPS];
+	out->polls = totals[SIMTEMP_STAT_POLLS];
+	out->bytes = totals[SIMTEMP_STAT_BYTES];
+	out->overflows = totals[SIMTEMP_STAT_OVERFLOWS];
+}
+
+static long simtemp_ioctl(struct file *file, unsigned int cmd,
+			  unsigned long arg)
+{
+	struct simtemp_reader *reader = simtemp_reader_from_file(file);
+	struct simtemp_device *sim = reader->sim;
+	void __user *argp = (void __user *)arg;
+
+	if (READ_ONCE(sim->stopping))
+		return -ENODEV;
+
+	switch (cmd) {
+	case SIMTEMP_IOC_GET_CONFIG: {
+		struct simtemp_config cfg;
+
+		mutex_lock(&sim->lock);
+		cfg = sim->cfg;
+		mutex_unlock(&sim->lock);
+
+		return copy_to_user(argp, &cfg, sizeof(cfg)) ? -EFAULT : 0;
+	}
+	case SIMTEMP_IOC_SET_CONFIG: {
+		struct simtemp_config cfg;
+
+		if (!(file->f_mode & FMODE_WRITE))
+			return -EBADF;
+		if (copy_from_user(&cfg, argp, sizeof(cfg)))
+			return -EFAULT;
+
+		/* Validate against the same state the apply will see. */
+		mutex_lock(&sim->lock);
+		if (simtemp_cfg_validate(sim, &cfg)) {
+			mutex_unlock(&sim->lock);
+			simtemp_stat_inc(sim, SIMTEMP_STAT_ERRORS);
+			return -EINVAL;
+		}
+		simtemp_cfg_apply(sim, &cfg);
+		mutex_unlock(&sim->lock);
+
+		return 0;
+	}
+	case SIMTEMP_IOC_GET_STATS: {
+		struct simtemp_stats stats;
+
+		simtemp_stats_fill(sim, &stats);
+
+		return copy_to_user(argp, &stats, sizeof(stats)) ? -EFAULT : 0;
+	}
+	case SIMTEMP_IOC_GET_LATEST: {
+		struct simtemp_sample sample;
+
+		if (!simtemp_latest_read(sim, &sample))
+			return -ENODATA;
+
+		return copy_to_user(argp, &sample, sizeof(sample)) ? -EFAULT : 0;
+	}
+	case SIMTEMP_IOC_GET_ALERT: {
+		struct simtemp_alert event;
+		u32 queued;
+		u32 lost;
+
+		spin_lock_irq(&sim->alert_lock);
+		queued = sim->alert_head - reader->alert_tail;
+		if (!queued) {
+			spin_unlock_irq(&sim->alert_lock);
+			return -EAGAIN;
+		}
+		lost = queued > SIMTEMP_ALERT_QUEUE_DEPTH ?
+		       queued - SIMTEMP_ALERT_QUEUE_DEPTH : 0U;
+		reader->alert_tail += lost;
+		event = sim->alerts[reader->alert_tail % SIMTEMP_ALERT_QUEUE_DEPTH];
+		reader->alert_tail++;
+		spin_unlock_irq(&sim->alert_lock);
+
+		event.lost = lost;
+
+		return copy_to_user(argp, &event, sizeof(event)) ? -EFAULT : 0;
+	}
+	case SIMTEMP_IOC_SET_STREAM: {
+		u32 stream;
+
+		if (get_user(stream, (u32 __user *)argp))
+			return -EFAULT;
+		if (stream >= SIMTEMP_STREAM_MAX)
+			return -EINVAL;
+
+		/*
+		 * Start the new stream at its live edge. Only raw readers hold
+		 * the producer back under the block policy, so the cursor is
+		 * moved before the producer can see the reader as raw again.
+		 */
+		mutex_lock(&reader->read_lock);
+		if (stream != reader->stream) {
+			spin_lock_irq(&sim->agg_lock);
+			WRITE_ONCE(reader->agg_tail, sim->agg_head);
+			spin_unlock_irq(&sim->agg_lock);
+			spin_lock_irq(&sim->readers_lock);
+			smp_store_release(&reader->ctrl->tail,
+					  smp_load_acquire(&sim->ctrl->head));
+			WRITE_ONCE(reader->stream, stream);
+			spin_unlock_irq(&sim->readers_lock);
+		}
+		mutex_unlock(&reader->read_lock);
+
+		return 0;
+	}
+	default:
+		return -ENOTTY;
+	}
+}
+
+static int simtemp_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct simtemp_reader *reader = simtemp_reader_from_file(file);
+	struct simtemp_device *sim = reader->sim;
+	unsigned long size = vma->vm_end - vma->vm_start;
+
+	if (READ_ONCE(sim->stopping))
+		return -ENODEV;
+	if (!(vma->vm_flags & VM_SHARED))
+		return -EINVAL;
+
+	switch (vma->vm_pgoff) {
+	case SIMTEMP_MMAP_PGOFF_READER:
+		if (size > PAGE_SIZE)
+			return -EINVAL;
+		return remap_vmalloc_range(vma, reader->ctrl, 0);
+	case SIMTEMP_MMAP_PGOFF_RING:
+		/* Shared by every reader, so nobody gets to scribble on it. */
+		if (vma->vm_flags & VM_WRITE)
+			return -EPERM;
+		if (size > sim->ring_area_size)
+			return -EINVAL;
+		simtemp_vm_flags_clear(vma, VM_MAYWRITE);
+		return remap_vmalloc_range(vma, sim->ring_area, 0);
+	default:
+		return -EINVAL;
+	}
+}
+
 static const struct file_operations simtemp_fops = {
 	.owner	= THIS_MODULE,
 	.open	= simtemp_open,
-	.read	= simtemp_read,
+	.release = simtemp_release,
+	.read_iter = simtemp_read_iter,
 	.poll	= simtemp_poll,
+	.unlocked_ioctl = simtemp_ioctl,
+	.compat_ioctl = compat_ptr_ioctl,
+	.mmap	= simtemp_mmap,
 	.llseek = noop_llseek,
 };
 
@@ -666,42 +3022,74 @@ static int simtemp_probe(struct platform_device *pdev)
 	struct simtemp_device *sim;
 	int ret;
 
-	sim = devm_kzalloc(&pdev->dev, sizeof(*sim), GFP_KERNEL);
+	/* Not devm: open files keep the device alive past unbind. */
+	sim = kzalloc(sizeof(*sim), GFP_KERNEL);
 	if (sim == NULL)
 		return -ENOMEM;
 
+	kref_init(&sim->ref);
 	mutex_init(&sim->lock);
-	spin_lock_init(&sim->buf_lock);
-	init_waitqueue_head(&sim->waitq);
-	timer_setup(&sim->sample_timer, simtemp_timer_cb, 0);
-	sim->sample_task = NULL;
-#if IS_ENABLED(CONFIG_HIGH_RES_TIMERS)
-	sim->use_thread = true;
-#else
-	sim->use_thread = false;
-#endif
+	INIT_LIST_HEAD(&sim->readers);
+	spin_lock_init(&sim->readers_lock);
+	simtemp_hrtimer_setup(&sim->sample_timer, simtemp_timer_cb,
+			      CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	sim->hres = IS_ENABLED(CONFIG_HIGH_RES_TIMERS);
 
 	sim->dev = &pdev->dev;
 	sim->class_dev = NULL;
-	sim->sampling_us = SIMTEMP_DEFAULT_SAMPLING_US;
-	sim->threshold_mc = SIMTEMP_DEFAULT_THRESHOLD_MC;
+	ret = simtemp_stats_alloc(sim);
+	if (ret < 0) {
+		simtemp_put(sim);
+		return ret;
+	}
+	seqlock_init(&sim->cfg_lock);
+	sim->cfg.sampling_us = SIMTEMP_DEFAULT_SAMPLING_US;
+	sim->cfg.threshold_mc = SIMTEMP_DEFAULT_THRESHOLD_MC;
+	sim->ring_depth = simtemp_ring_depth_sanitize(&pdev->dev, ring_depth,
+						      "ring_depth");
+	sim->open_count = 0U;
 	sim->head = 0U;
-	sim->tail = 0U;
-	sim->ring_count = 0U;
-	sim->pending_events = 0U;
-	sim->alert_count = 0U;
-	sim->updates = 0U;
-	sim->alerts = 0U;
-	sim->errors = 0U;
+	spin_lock_init(&sim->alert_lock);
+	sim->alert_head = 0U;
+	sim->wake_alert = 0U;
+	spin_lock_init(&sim->agg_lock);
+	seqcount_init(&sim->latest_seq);
+	sim->agg_head = 0U;
+	sim->wake_agg = 0U;
+	sim->agg.count = 0U;
+	sim->agg_window = 0U;
+	sim->alert_active = false;
 	sim->stopping = false;
 	sim->last_temp_mc = SIMTEMP_DEFAULT_THRESHOLD_MC;
-	simtemp_set_mode(sim, SIMTEMP_DEFAULT_MODE);
+	sim->cfg.mode = SIMTEMP_DEFAULT_MODE;
+	sim->cfg.overflow_policy = SIMTEMP_DEFAULT_OVERFLOW;
+	sim->cfg.lowat = SIMTEMP_DEFAULT_LOWAT;
+	sim->cfg.max_latency_us = 0U;
+	sim->cfg.burst = 1U;
+	sim->cfg.hysteresis_mc = 0U;
+	sim->cfg.agg_window = 0U;
+	sim->cfg.clock = SIMTEMP_DEFAULT_CLOCK;
+	sim->cfg.seed = 0U;
+	sim->cfg.replay_loop = 0U;
+	sim->cfg.wave_amplitude_mc = SIMTEMP_DEFAULT_WAVE_AMPLITUDE_MC;
+	sim->cfg.wave_offset_mc = SIMTEMP_DEFAULT_WAVE_OFFSET_MC;
+	sim->cfg.wave_period = SIMTEMP_DEFAULT_WAVE_PERIOD;
+	sim->prod_clock = SIMTEMP_DEFAULT_CLOCK;
+	sim->prod_mode = SIMTEMP_MODE_MAX;
+	sim->seq = 0U;
 
 	simtemp_parse_dt(sim);
+	simtemp_seed_generator(sim);
+
+	ret = simtemp_ring_alloc(sim);
+	if (ret < 0) {
+		simtemp_put(sim);
+		return ret;
+	}
 
 	ret = ida_alloc(&simtemp_ida, GFP_KERNEL);
 	if (ret < 0) {
-		mutex_destroy(&sim->lock);
+		simtemp_put(sim);
 		return ret;
 	}
 	sim->id = ret;
@@ -709,11 +3097,13 @@ static int simtemp_probe(struct platform_device *pdev)
 	ret = simtemp_sysfs_register(sim);
 	if (ret < 0) {
 		ida_free(&simtemp_ida, sim->id);
-		mutex_destroy(&sim->lock);
+		simtemp_put(sim);
 		return ret;
 	}
 
-	strscpy(sim->chardev_name, SIMTEMP_DRIVER_NAME, sizeof(sim->chardev_name));
+	/* /dev/simtempN matches /sys/class/simtemp/simtempN. */
+	snprintf(sim->chardev_name, sizeof(sim->chardev_name),
+		 SIMTEMP_DEVICE_NAME_FMT, sim->id);
 	sim->miscdev.minor = MISC_DYNAMIC_MINOR;
 	sim->miscdev.name = sim->chardev_name;
 	sim->miscdev.fops = &simtemp_fops;
@@ -724,32 +3114,26 @@ static int simtemp_probe(struct platform_device *pdev)
 	if (ret) {
 		simtemp_sysfs_unregister(sim);
 		ida_free(&simtemp_ida, sim->id);
-		mutex_destroy(&sim->lock);
+		simtemp_put(sim);
 		return ret;
 	}
 
 	platform_set_drvdata(pdev, sim);
+	simtemp_debugfs_register(sim);
+	simtemp_hwmon_register(sim);
 
-	if (sim->use_thread) {
-		sim->sample_task = kthread_run(simtemp_worker_thread, sim,
-				            "simtemp/%d", sim->id);
-		if (IS_ERR(sim->sample_task)) {
-			dev_warn(&pdev->dev,
-				 "failed to start worker thread; falling back to timer path\n");
-			sim->sample_task = NULL;
-			sim->use_thread = false;
-		}
-	}
-
+	mutex_lock(&sim->lock);
 	simtemp_restart_timer(sim);
+	mutex_unlock(&sim->lock);
 
 	dev_info(&pdev->dev,
-		 "%s probed%s (sampling=%uus threshold=%d mC%s)\n",
-		 SIMTEMP_DRIVER_NAME,
+		 "%s probed%s (sampling=%uus threshold=%d mC ring=%u%s)\n",
+		 sim->chardev_name,
 		 (pdev->dev.of_node != NULL) ? " (DT match)" : " (name match)",
-		 sim->sampling_us,
-		 sim->threshold_mc,
-		 sim->use_thread ? " worker" : "");
+		 sim->cfg.sampling_us,
+		 sim->cfg.threshold_mc,
+		 sim->ring_depth,
+		 sim->hres ? " hres" : "");
 
 	return 0;
 }
@@ -757,26 +3141,28 @@ static int simtemp_probe(struct platform_device *pdev)
 static int simtemp_remove_int(struct platform_device *pdev)
 {
 	struct simtemp_device *sim;
+	struct simtemp_reader *reader;
 
 	sim = platform_get_drvdata(pdev);
 	platform_set_drvdata(pdev, NULL);
 
 	if (sim != NULL) {
+		/* Under @lock so no config change can re-arm the timer. */
+		mutex_lock(&sim->lock);
 		WRITE_ONCE(sim->stopping, true);
-		wake_up_interruptible(&sim->waitq);
-		if (READ_ONCE(sim->use_thread)) {
-#if IS_ENABLED(CONFIG_HIGH_RES_TIMERS)
-			if (sim->sample_task)
-				kthread_stop(sim->sample_task);
-			sim->sample_task = NULL;
-#endif
-		} else {
-			simtemp_timer_shutdown(&sim->sample_timer);
-		}
+		mutex_unlock(&sim->lock);
+		spin_lock_irq(&sim->readers_lock);
+		list_for_each_entry(reader, &sim->readers, node)
+			wake_up_interruptible_all(&reader->waitq);
+		spin_unlock_irq(&sim->readers_lock);
+		hrtimer_cancel(&sim->sample_timer);
+		debugfs_remove_recursive(sim->debugfs);
+		simtemp_hwmon_unregister(sim);
 		misc_deregister(&sim->miscdev);
 		simtemp_sysfs_unregister(sim);
 		ida_free(&simtemp_ida, sim->id);
-		mutex_destroy(&sim->lock);
+		/* Freed here, or by the release of the last open file. */
+		simtemp_put(sim);
 	}
 
     dev_info(&pdev->dev, "%s remove\n", SIMTEMP_DRIVER_NAME);
@@ -825,27 +3211,36 @@ static int __init simtemp_init(void)
 	if (IS_ERR(simtemp_class))
 		return PTR_ERR(simtemp_class);
 
+	simtemp_debugfs_root = debugfs_create_dir(SIMTEMP_DRIVER_NAME, NULL);
+
 	ret = platform_driver_register(&simtemp_driver);
 	if (ret != 0) {
+		debugfs_remove_recursive(simtemp_debugfs_root);
 		class_destroy(simtemp_class);
 		simtemp_class = NULL;
 		return ret;
 	}
 
 	if (force_create_dev != false) {
-		simtemp_pdev = platform_device_register_simple(SIMTEMP_DRIVER_NAME,
-								  -1, NULL, 0);
-		if (IS_ERR(simtemp_pdev)) {
-			ret = PTR_ERR(simtemp_pdev);
+		unsigned int count = clamp_t(unsigned int, num_devices, 1U,
+					     SIMTEMP_MAX_FORCED_DEVICES);
+
+		if (count != num_devices)
+			pr_warn("%s: num_devices=%u out of range, using %u\n",
+				SIMTEMP_DRIVER_NAME, num_devices, count);
+
+		ret = simtemp_forced_devices_register(count);
+		if (ret != 0) {
 			pr_err("%s: failed to create temp platform_device: %d\n",
 			       SIMTEMP_DRIVER_NAME, ret);
 			platform_driver_unregister(&simtemp_driver);
+			debugfs_remove_recursive(simtemp_debugfs_root);
 			class_destroy(simtemp_class);
 			simtemp_class = NULL;
 			return ret;
 		}
-		pr_info("%s: temporary platform_device created (no DT)\n",
-			SIMTEMP_DRIVER_NAME);
+		pr_info("%s: %u temporary platform_device(s) created (no DT)\n",
+			SIMTEMP_DRIVER_NAME, count);
 	}
 
 	return 0;
@@ -853,15 +3248,15 @@ static int __init simtemp_init(void)
 
 static void __exit simtemp_exit(void)
 {
-	if ((simtemp_pdev != NULL) && !IS_ERR(simtemp_pdev)) {
-		platform_device_unregister(simtemp_pdev);
-		pr_info("%s: temporary platform_device removed\n",
+	if (simtemp_pdev_count > 0U) {
+		simtemp_forced_devices_unregister();
+		pr_info("%s: temporary platform_device(s) removed\n",
 			SIMTEMP_DRIVER_NAME);
-		simtemp_pdev = NULL;
 	}
 
 	platform_driver_unregister(&simtemp_driver);
 	ida_destroy(&simtemp_ida);
+	debugfs_remove_recursive(simtemp_debugfs_root);
 
 	if (simtemp_class != NULL) {
 		class_destroy(simtemp_class);
@@ -875,7 +3270,3 @@ module_exit(simtemp_exit);
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Rodrigo Rea");
 MODULE_DESCRIPTION("NXP Simulated Temperature Sensor (data path skeleton)");
-#if IS_ENABLED(CONFIG_HIGH_RES_TIMERS)
-extern void hrtimer_init(struct hrtimer *timer, clockid_t which_clock,
-			 enum hrtimer_mode mode);
-#endif
@@ -6,17 +6,23 @@
 
 #include <linux/bits.h>
 #include <linux/device.h>
+#include <linux/cache.h>
+#include <linux/hrtimer.h>
+#include <linux/kref.h>
+#include <linux/list.h>
 #include <linux/miscdevice.h>
-#include <linux/kthread.h>
 #include <linux/mutex.h>
+#include <linux/prandom.h>
+#include <linux/seqlock.h>
 #include <linux/spinlock.h>
-#include <linux/timer.h>
 #include <linux/types.h>
+#include <linux/u64_stats_sync.h>
 #include <linux/wait.h>
 
 #define SIMTEMP_DRIVER_NAME          "nxp_simtemp"
 #define SIMTEMP_CLASS_NAME           "simtemp"
 #define SIMTEMP_DEVICE_NAME_FMT      "simtemp%d"
+#define SIMTEMP_MAX_FORCED_DEVICES   64U
 #define SIMTEMP_COMPATIBLE           "nxp,simtemp"
 
 #define SIMTEMP_DEFAULT_SAMPLING_MS  (100U)
@@ -27,73 +33,251 @@
 #define SIMTEMP_SAMPLING_US_MIN      (100U)
 #define SIMTEMP_SAMPLING_US_MAX      (SIMTEMP_SAMPLING_MS_MAX * 1000U)
 
-#define SIMTEMP_RING_DEPTH           (64U)
+#define SIMTEMP_DEFAULT_LOWAT        (1U)
+#define SIMTEMP_BURST_MAX            (1024U)
+#define SIMTEMP_MAX_LATENCY_US_MAX   (SIMTEMP_SAMPLING_US_MAX)
+#define SIMTEMP_HYSTERESIS_MC_MAX    (60000U)
+#define SIMTEMP_ALERT_QUEUE_DEPTH    (32U)
+#define SIMTEMP_AGG_QUEUE_DEPTH      (64U)
+#define SIMTEMP_AGG_WINDOW_MAX       (1U << 20)
+#define SIMTEMP_REPLAY_MAX_SAMPLES   (1U << 22)
+#define SIMTEMP_WAVE_LUT_SIZE        (256U)
+#define SIMTEMP_WAVE_AMPLITUDE_MAX   (100000U)
+#define SIMTEMP_WAVE_OFFSET_MIN      (-100000)
+#define SIMTEMP_WAVE_OFFSET_MAX      (200000)
+#define SIMTEMP_WAVE_PERIOD_MIN      (2U)
+#define SIMTEMP_WAVE_PERIOD_MAX      (1U << 24)
+#define SIMTEMP_DEFAULT_WAVE_AMPLITUDE_MC (10000U)
+#define SIMTEMP_DEFAULT_WAVE_OFFSET_MC    (45000)
+#define SIMTEMP_DEFAULT_WAVE_PERIOD       (100U)
 
-#define SIMTEMP_EVENT_SAMPLE         BIT(0)
-#define SIMTEMP_EVENT_THRESHOLD      BIT(1)
+#define SIMTEMP_DEFAULT_RING_DEPTH   (64U)
+#define SIMTEMP_RING_DEPTH_MIN       (16U)
+#define SIMTEMP_RING_DEPTH_MAX       (1U << 18)
+
+/**
+ * enum simtemp_stat - per-CPU statistics counters, in `stats` output order
+ * @SIMTEMP_STAT_UPDATES:     samples generated
+ * @SIMTEMP_STAT_ALERTS:      rising threshold crossings
+ * @SIMTEMP_STAT_ERRORS:      error events (invalid inputs, copy faults)
+ * @SIMTEMP_STAT_MISSED:      sampling periods skipped because the producer ran late
+ * @SIMTEMP_STAT_OVERWRITTEN: samples readers lost because the producer lapped them
+ * @SIMTEMP_STAT_READS:       read() calls that returned data
+ * @SIMTEMP_STAT_WAKEUPS:     wakeups issued to sleeping readers
+ * @SIMTEMP_STAT_POLLS:       poll() calls
+ * @SIMTEMP_STAT_BYTES:       bytes delivered through read()
+ * @SIMTEMP_STAT_OVERFLOWS:   ticks that found the ring full under the
+ *                            drop-newest or block overflow policy
+ * @SIMTEMP_STAT_MAX:         number of counters
+ */
+enum simtemp_stat {
+	SIMTEMP_STAT_UPDATES = 0,
+	SIMTEMP_STAT_ALERTS,
+	SIMTEMP_STAT_ERRORS,
+	SIMTEMP_STAT_MISSED,
+	SIMTEMP_STAT_OVERWRITTEN,
+	SIMTEMP_STAT_READS,
+	SIMTEMP_STAT_WAKEUPS,
+	SIMTEMP_STAT_POLLS,
+	SIMTEMP_STAT_BYTES,
+	SIMTEMP_STAT_OVERFLOWS,
+	SIMTEMP_STAT_MAX
+};
+
+/**
+ * enum simtemp_hist - log2 histograms exported through debugfs
+ * @SIMTEMP_HIST_JITTER:  how late the hrtimer callback ran versus its expiry
+ * @SIMTEMP_HIST_LATENCY: sample timestamp to read() hand-out, per record
+ * @SIMTEMP_HIST_MAX:     number of histograms
+ */
+enum simtemp_hist {
+	SIMTEMP_HIST_JITTER = 0,
+	SIMTEMP_HIST_LATENCY,
+	SIMTEMP_HIST_MAX
+};
+
+/*
+ * Bucket 0 counts 0 ns, bucket b covers [2^(b-1), 2^b) ns and the last
+ * bucket collects everything from 2^30 ns (~1.07 s) up.
+ */
+#define SIMTEMP_HIST_BUCKETS 32U
+
+/**
+ * struct simtemp_pcpu_stats - one CPU's share of the device counters
+ * @cnt:   counters indexed by enum simtemp_stat
+ * @hist:  histogram buckets indexed by enum simtemp_hist
+ * @syncp: makes the 64-bit counters tear-free on 32-bit hosts
+ */
+struct simtemp_pcpu_stats {
+	u64_stats_t cnt[SIMTEMP_STAT_MAX];
+	u64_stats_t hist[SIMTEMP_HIST_MAX][SIMTEMP_HIST_BUCKETS];
+	struct u64_stats_sync syncp;
+};
 
 /**
  * struct simtemp_device - runtime state for a simulated temperature device
+ * @ref:             held by probe and by every open file; the last put frees
+ *                   the ring and the device, so open files outlive unbind
  * @dev:             backing platform device pointer
  * @class_dev:       sysfs class device under /sys/class/simtemp/
  * @miscdev:         character device interface (/dev/simtemp)
- * @lock:            protects configuration fields
- * @buf_lock:        protects ring buffer and event state
- * @waitq:           waitqueue used for blocking reads and poll()
- * @sampling_ms:     sampling interval in milliseconds
- * @threshold_mc:    threshold in milli degrees Celsius
+ * @lock:            serialises configuration changes and other slow paths
+ * @cfg:             current configuration; written under @lock and @cfg_lock
+ * @cfg_lock:        lets the producer snapshot @cfg without tearing
  * @id:              allocator-provided unique identifier
- * @ring:            FIFO of generated samples
- * @head:            ring buffer head index
- * @tail:            ring buffer tail index
- * @ring_count:      number of valid samples in the buffer
- * @pending_events:  event bits exposed through poll()
- * @alert_count:     number of samples in buffer carrying the alert flag
- * @stopping:        module is shutting down (unload path)
- * @last_temp_mc:    last simulated temperature value (milli °C)
- * @sample_timer:    periodic timer producing samples
+ * @ring_area:       vmalloc_user() area exported through mmap()
+ * @ring_area_size:  size of @ring_area in bytes
+ * @ctrl:            read-only ring header at the start of @ring_area
+ * @ring:            FIFO of generated samples, one page into @ring_area
+ * @ring_depth:      number of records in @ring (power of two)
+ * @ring_mask:       @ring_depth - 1, maps free-running indices to slots
+ * @open_count:      open file descriptors; the ring is only resized at zero
+ * @readers:         open readers, walked by the producer to find the oldest cursor
+ * @readers_lock:    protects @readers against open/release
+ * @stopping:        device is being unbound; file operations fail with -ENODEV
+ * @sample_timer:    hrtimer producing samples on absolute expiries
+ * @hres:            high resolution timers available (sub-millisecond periods)
  * @chardev_name:    name assigned to the miscdevice
- * @updates:         total samples generated
- * @alerts:          total samples that crossed the threshold
- * @errors:          total error events (invalid inputs, copy faults)
- * @mode:            current simulation mode
+ * @stats:           per-CPU counters, summed when `stats` is read
+ * @hist_base:       histogram totals at the last debugfs reset (under @lock)
+ * @debugfs:         per-device debugfs directory
+ * @hwmon:           hwmon device, or NULL if registration failed
+ * @replay:          trace played back in replay mode (kvmalloc, milli °C)
+ * @replay_len:      number of values in @replay (0 = no trace loaded)
+ * @replay_name:     firmware file @replay was loaded from
+ * @alerts:          threshold crossing events, indexed by @alert_head
+ * @alert_lock:      protects @alerts, @alert_head and the readers' cursors
+ * @alert_head:      number of events ever queued (free running)
+ * @aggs:            completed aggregate records, indexed by @agg_head
+ * @agg_lock:        protects @aggs, @agg_head and the readers' @agg_tail
+ * @agg_head:        number of aggregates ever completed (free running)
+ * @latest_seq:      lets readers snapshot @latest without locking
+ * @latest:          most recently generated sample (flags 0 before the first)
+ * @head:            producer index (private copy of @ctrl->head)
+ * @alert_active:    last sample was above the threshold (with hysteresis)
+ * @rnd:             noise generator state, seeded from @cfg.seed
+ * @replay_pos:      next @replay index played back
+ * @wave_lut:        one period of the current periodic mode, already scaled
+ *                   by amplitude and offset
+ * @wave_amplitude_mc: amplitude @wave_lut was built for
+ * @wave_offset_mc:  offset @wave_lut was built for
+ * @wave_period:     period @wave_idx/@wave_frac advance for
+ * @wave_idx:        @wave_lut entry of the next sample
+ * @wave_frac:       fractional index, in 1/@wave_period table entries
+ * @last_temp_mc:    last simulated temperature value (milli °C)
  * @ramp_increasing: ramp direction flag used in ramp mode
+ * @prod_mode:       mode the generator state was last initialised for
+ * @prod_clock:      clock the producer last stamped with
+ * @wake_head:       @head at the last reader wakeup
+ * @wake_alert:      @alert_head at the last reader wakeup
+ * @wake_agg:        @agg_head at the last reader wakeup
+ * @agg:             window being accumulated; @agg.count samples so far
+ * @agg_sum:         sum of the temperatures in @agg
+ * @agg_window:      window length @agg was started with
+ * @pending_since:   timestamp of the first sample published after @wake_head
+ * @seq:             sequence number of the next generated sample
+ * @min_tail:        cached oldest reader cursor, refreshed only when the ring
+ *                   looks full against it
+ *
+ * Everything from @head on is written only by the producer (the hrtimer
+ * callback) and lives on its own cache line, away from the read-mostly
+ * configuration and ring pointers that readers dereference.
  */
 struct simtemp_device {
+	struct kref ref;
 	struct device *dev;
 	struct device *class_dev;
 	struct miscdevice miscdev;
 	struct mutex lock;
-	spinlock_t buf_lock;
-	wait_queue_head_t waitq;
-	u32 sampling_us;
-	s32 threshold_mc;
+	struct simtemp_config cfg;
+	seqlock_t cfg_lock;
 	int id;
-	struct simtemp_sample ring[SIMTEMP_RING_DEPTH];
-	u32 head;
-	u32 tail;
-	u32 ring_count;
-	u32 pending_events;
-	u32 alert_count;
+	void *ring_area;
+	size_t ring_area_size;
+	struct simtemp_ring_ctrl *ctrl;
+	struct simtemp_sample *ring;
+	u32 ring_depth;
+	u32 ring_mask;
+	unsigned int open_count;
+	struct list_head readers;
+	spinlock_t readers_lock;
 	bool stopping;
-	s32 last_temp_mc;
-	struct timer_list sample_timer;
-	struct task_struct *sample_task;
-	bool use_thread;
+	struct hrtimer sample_timer;
+	bool hres;
 	char chardev_name[32];
-	u32 updates;
-	u32 alerts;
-	u32 errors;
-	enum simtemp_mode {
-		SIMTEMP_MODE_NORMAL = 0,
-		SIMTEMP_MODE_NOISY,
-		SIMTEMP_MODE_RAMP,
-		SIMTEMP_MODE_MAX
-	} mode;
+	struct simtemp_pcpu_stats __percpu *stats;
+	u64 hist_base[SIMTEMP_HIST_MAX][SIMTEMP_HIST_BUCKETS];
+	struct dentry *debugfs;
+	struct device *hwmon;
+	s32 *replay;
+	u32 replay_len;
+	char replay_name[64];
+	struct simtemp_alert alerts[SIMTEMP_ALERT_QUEUE_DEPTH];
+	spinlock_t alert_lock;
+	u32 alert_head;
+	struct simtemp_aggregate aggs[SIMTEMP_AGG_QUEUE_DEPTH];
+	spinlock_t agg_lock;
+	u32 agg_head;
+
+	seqcount_t latest_seq ____cacheline_aligned_in_smp;
+	struct simtemp_sample latest;
+
+	u32 head ____cacheline_aligned_in_smp;
+	bool alert_active;
+	struct rnd_state rnd;
+	u32 replay_pos;
+	s32 wave_lut[SIMTEMP_WAVE_LUT_SIZE];
+	u32 wave_amplitude_mc;
+	s32 wave_offset_mc;
+	u32 wave_period;
+	u32 wave_idx;
+	u32 wave_frac;
+	s32 last_temp_mc;
 	bool ramp_increasing;
+	enum simtemp_mode prod_mode;
+	enum simtemp_clock prod_clock;
+	u32 wake_head;
+	u32 wake_alert;
+	u32 wake_agg;
+	struct simtemp_aggregate agg;
+	s64 agg_sum;
+	u32 agg_window;
+	u64 pending_since;
+	u64 seq;
+	u32 min_tail;
 };
 
 #define SIMTEMP_DEFAULT_MODE          SIMTEMP_MODE_NORMAL
+#define SIMTEMP_DEFAULT_OVERFLOW      SIMTEMP_OVERFLOW_DROP_OLDEST
+#define SIMTEMP_DEFAULT_CLOCK         SIMTEMP_CLOCK_MONOTONIC
+
+/**
+ * struct simtemp_reader - per open file state of the character device
+ * @sim:  device being read
+ * @ctrl: vmalloc_user() page holding this reader's cursor, mappable at
+ *        SIMTEMP_MMAP_PGOFF_READER
+ * @read_lock: serialises read() calls sharing this cursor
+ * @bounce: staging page records are validated in before copy_to_user()
+ * @node: entry in &simtemp_device.readers
+ * @alert_tail: next alert event this reader will consume (under
+ *              &simtemp_device.alert_lock)
+ * @stream: enum simtemp_stream read() hands out; changed under @read_lock
+ *          and &simtemp_device.readers_lock
+ * @agg_tail: next aggregate this reader will consume (under
+ *            &simtemp_device.agg_lock)
+ * @waitq: blocking read() (exclusive) and poll() waiters on this file
+ */
+struct simtemp_reader {
+	struct simtemp_device *sim;
+	struct list_head node;
+	struct simtemp_reader_ctrl *ctrl;
+	struct mutex read_lock;
+	struct simtemp_sample *bounce;
+	u32 alert_tail;
+	u32 stream;
+	u32 agg_tail;
+	wait_queue_head_t waitq;
+};
 
 int simtemp_sysfs_register(struct simtemp_device *sim);
 void simtemp_sysfs_unregister(struct simtemp_device *sim);
@@ -9,17 +9,291 @@
 
 #define SIMTEMP_SAMPLE_FLAG_NEW_SAMPLE       (1U << 0)
 #define SIMTEMP_SAMPLE_FLAG_THRESHOLD_ALERT  (1U << 1)
+#define SIMTEMP_SAMPLE_FLAG_ALERT_RISING     (1U << 2)
+#define SIMTEMP_SAMPLE_FLAG_ALERT_FALLING    (1U << 3)
 
 /**
  * struct simtemp_sample - sample record shared between kernel and user space
- * @timestamp_ns: monotonic timestamp when the sample was produced
+ * @timestamp_ns: when the sample was produced, on the device's clock
+ *                (simtemp_config.clock, CLOCK_MONOTONIC by default)
  * @temp_mc:      temperature in milli degrees Celsius
- * @flags:        event flags (bit0=new sample, bit1=threshold crossed)
+ * @flags:        event flags (bit0=new sample, bit1=alert active,
+ *                bit2=rising crossing, bit3=falling crossing)
+ * @seq:          per-device sequence number, +1 for every generated sample;
+ *                a jump means samples were overwritten or dropped
+ *
+ * Naturally aligned (24 bytes, no padding), so the layout is the same for
+ * every ABI and the header stays usable from C and C++ user space.
  */
 struct simtemp_sample {
 	__u64 timestamp_ns;
 	__s32 temp_mc;
 	__u32 flags;
-} __packed;
+	__u64 seq;
+};
 
+/**
+ * enum simtemp_mode - temperature generator selected by simtemp_config.mode
+ * @SIMTEMP_MODE_NORMAL: small random walk
+ * @SIMTEMP_MODE_NOISY:  random walk with three times the step
+ * @SIMTEMP_MODE_RAMP:   triangle wave between the simulator limits
+ * @SIMTEMP_MODE_REPLAY: play back the loaded trace (sysfs replay_trace),
+ *                       one value per sample
+ * @SIMTEMP_MODE_SINE:   sine wave (wave_* fields of struct simtemp_config)
+ * @SIMTEMP_MODE_SQUARE: square wave, high for the first half period
+ * @SIMTEMP_MODE_SAWTOOTH: linear rise from offset - amplitude, then drop
+ * @SIMTEMP_MODE_STEP:   eight-level staircase rising over one period
+ * @SIMTEMP_MODE_MAX:    number of modes
+ *
+ * The periodic modes are exact functions of the sample index: sample k
+ * after entering the mode (or changing a wave_* field) reads entry
+ * k * 256 / wave_period (mod 256) of a 256-entry table, so a consumer can
+ * check every value it receives against its seq.
+ */
+enum simtemp_mode {
+	SIMTEMP_MODE_NORMAL = 0,
+	SIMTEMP_MODE_NOISY,
+	SIMTEMP_MODE_RAMP,
+	SIMTEMP_MODE_REPLAY,
+	SIMTEMP_MODE_SINE,
+	SIMTEMP_MODE_SQUARE,
+	SIMTEMP_MODE_SAWTOOTH,
+	SIMTEMP_MODE_STEP,
+	SIMTEMP_MODE_MAX
+};
+
+/**
+ * enum simtemp_overflow_policy - producer behaviour once a reader is a full
+ *                                ring behind (simtemp_config.overflow_policy)
+ * @SIMTEMP_OVERFLOW_DROP_OLDEST: overwrite; the lapped reader counts overruns
+ * @SIMTEMP_OVERFLOW_DROP_NEWEST: discard the new sample, leaving a seq gap
+ * @SIMTEMP_OVERFLOW_BLOCK:       stop generating until the reader catches up
+ * @SIMTEMP_OVERFLOW_MAX:         number of policies
+ */
+enum simtemp_overflow_policy {
+	SIMTEMP_OVERFLOW_DROP_OLDEST = 0,
+	SIMTEMP_OVERFLOW_DROP_NEWEST,
+	SIMTEMP_OVERFLOW_BLOCK,
+	SIMTEMP_OVERFLOW_MAX
+};
+
+/**
+ * enum simtemp_clock - clock sample timestamps are taken from
+ *                      (simtemp_config.clock)
+ * @SIMTEMP_CLOCK_MONOTONIC:        CLOCK_MONOTONIC (default)
+ * @SIMTEMP_CLOCK_BOOTTIME:         CLOCK_BOOTTIME, keeps counting in suspend
+ * @SIMTEMP_CLOCK_MONOTONIC_RAW:    CLOCK_MONOTONIC_RAW, free of NTP slewing
+ * @SIMTEMP_CLOCK_REALTIME:         CLOCK_REALTIME, jumps when the time is set
+ * @SIMTEMP_CLOCK_MONOTONIC_COARSE: CLOCK_MONOTONIC_COARSE, tick resolution
+ *                                  but no clocksource read per sample
+ * @SIMTEMP_CLOCK_REALTIME_COARSE:  CLOCK_REALTIME_COARSE, likewise
+ * @SIMTEMP_CLOCK_MAX:              number of clocks
+ */
+enum simtemp_clock {
+	SIMTEMP_CLOCK_MONOTONIC = 0,
+	SIMTEMP_CLOCK_BOOTTIME,
+	SIMTEMP_CLOCK_MONOTONIC_RAW,
+	SIMTEMP_CLOCK_REALTIME,
+	SIMTEMP_CLOCK_MONOTONIC_COARSE,
+	SIMTEMP_CLOCK_REALTIME_COARSE,
+	SIMTEMP_CLOCK_MAX
+};
+
+/**
+ * enum simtemp_stream - record stream read() returns (SIMTEMP_IOC_SET_STREAM)
+ * @SIMTEMP_STREAM_RAW:       every sample, as struct simtemp_sample (default)
+ * @SIMTEMP_STREAM_AGGREGATE: one struct simtemp_aggregate per window
+ * @SIMTEMP_STREAM_MAX:       number of streams
+ */
+enum simtemp_stream {
+	SIMTEMP_STREAM_RAW = 0,
+	SIMTEMP_STREAM_AGGREGATE,
+	SIMTEMP_STREAM_MAX
+};
+
+/**
+ * struct simtemp_aggregate - summary of agg_window consecutive samples
+ * @timestamp_ns: timestamp of the last sample in the window
+ * @first_seq:    sequence number of the first sample in the window
+ * @min_mc:       lowest temperature in the window (milli degrees Celsius)
+ * @max_mc:       highest temperature in the window
+ * @mean_mc:      arithmetic mean, rounded towards zero
+ * @count:        samples summarised (agg_window at the time)
+ * @flags:        SIMTEMP_SAMPLE_FLAG_THRESHOLD_ALERT if any sample had it
+ * @reserved:     zero
+ *
+ * Windows cover every generated sample, including ones the raw ring
+ * dropped, so aggregates do not depend on how fast raw readers drain.
+ */
+struct simtemp_aggregate {
+	__u64 timestamp_ns;
+	__u64 first_seq;
+	__s32 min_mc;
+	__s32 max_mc;
+	__s32 mean_mc;
+	__u32 count;
+	__u32 flags;
+	__u32 reserved;
+};
+
+/**
+ * struct simtemp_config - complete device configuration
+ * @sampling_us:     producer period in microseconds
+ * @threshold_mc:    alert threshold in milli degrees Celsius
+ * @hysteresis_mc:   an active alert clears once the temperature drops below
+ *                   threshold_mc - hysteresis_mc (0 = at the threshold)
+ * @agg_window:      samples per aggregate record (0 = aggregation off)
+ * @clock:           enum simtemp_clock used for timestamps
+ * @seed:            noise generator seed; a given seed replays the same
+ *                   waveform (0 = pick a random seed)
+ * @replay_loop:     replay mode restarts the trace at its end (0 = stop
+ *                   generating samples after the last value)
+ * @wave_amplitude_mc: peak deviation of the periodic modes from the offset
+ * @wave_offset_mc:  centre of the periodic modes (milli degrees Celsius)
+ * @wave_period:     samples per cycle of the periodic modes
+ * @mode:            enum simtemp_mode
+ * @overflow_policy: enum simtemp_overflow_policy
+ * @lowat:           readers become ready once this many samples are queued
+ *                   (1 = every sample; capped at the ring depth)
+ * @max_latency_us:  ...or once the oldest queued sample is this old
+ *                   (0 = no time bound); alert events always wake
+ * @burst:           samples generated per producer tick (1 = off), with
+ *                   timestamps spread evenly over the period
+ * @reserved:        must be zero
+ *
+ * SIMTEMP_IOC_SET_CONFIG validates the whole structure and applies it in one
+ * step: the producer never sees a mix of old and new fields. Read it back
+ * with SIMTEMP_IOC_GET_CONFIG, modify and write it to change a subset.
+ */
+struct simtemp_config {
+	__u32 sampling_us;
+	__s32 threshold_mc;
+	__u32 mode;
+	__u32 overflow_policy;
+	__u32 lowat;
+	__u32 max_latency_us;
+	__u32 burst;
+	__u32 hysteresis_mc;
+	__u32 agg_window;
+	__u32 clock;
+	__u64 seed;
+	__u32 replay_loop;
+	__u32 wave_amplitude_mc;
+	__s32 wave_offset_mc;
+	__u32 wave_period;
+	__u32 reserved[8];
+};
+
+/**
+ * struct simtemp_alert - threshold crossing event (SIMTEMP_IOC_GET_ALERT)
+ * @timestamp_ns: timestamp of the sample that crossed
+ * @seq:          sequence number of that sample in the data stream
+ * @temp_mc:      its temperature in milli degrees Celsius
+ * @flags:        SIMTEMP_SAMPLE_FLAG_ALERT_RISING or _FALLING
+ * @lost:         events this reader missed just before this one because it
+ *                fell a whole alert queue behind
+ * @reserved:     zero
+ *
+ * Crossings are queued separately from the data stream, per open file and
+ * with their own cursor, so an alert consumer never has to drain samples.
+ */
+struct simtemp_alert {
+	__u64 timestamp_ns;
+	__u64 seq;
+	__s32 temp_mc;
+	__u32 flags;
+	__u32 lost;
+	__u32 reserved;
+};
+
+/**
+ * struct simtemp_stats - binary snapshot of the `stats` sysfs counters
+ * @updates:     samples generated
+ * @alerts:      rising threshold crossings
+ * @errors:      error events (invalid inputs, copy faults)
+ * @missed:      sampling periods skipped because the producer ran late
+ * @overwritten: samples readers lost because the producer lapped them
+ * @reads:       read() calls that returned data
+ * @wakeups:     wakeups issued to sleeping readers
+ * @polls:       poll() calls
+ * @bytes:       bytes delivered through read()
+ * @overflows:   ticks that found the ring full under drop-newest or block
+ * @reserved:    zero
+ */
+struct simtemp_stats {
+	__u64 updates;
+	__u64 alerts;
+	__u64 errors;
+	__u64 missed;
+	__u64 overwritten;
+	__u64 reads;
+	__u64 wakeups;
+	__u64 polls;
+	__u64 bytes;
+	__u64 overflows;
+	__u64 reserved[6];
+};
+
+#define SIMTEMP_IOC_GET_CONFIG  _IOR(SIMTEMP_IOCTL_MAGIC, 0x01, struct simtemp_config)
+/* Needs a descriptor opened for writing; -EINVAL leaves the config untouched. */
+#define SIMTEMP_IOC_SET_CONFIG  _IOW(SIMTEMP_IOCTL_MAGIC, 0x02, struct simtemp_config)
+#define SIMTEMP_IOC_GET_STATS   _IOR(SIMTEMP_IOCTL_MAGIC, 0x03, struct simtemp_stats)
+/* Pops one alert event; -EAGAIN when none is queued (wait with POLLPRI). */
+#define SIMTEMP_IOC_GET_ALERT   _IOR(SIMTEMP_IOCTL_MAGIC, 0x04, struct simtemp_alert)
+/*
+ * Selects what read() on this descriptor returns (enum simtemp_stream). The
+ * new stream starts at its live edge; mmap() always exposes the raw ring.
+ */
+#define SIMTEMP_IOC_SET_STREAM  _IOW(SIMTEMP_IOCTL_MAGIC, 0x05, __u32)
+/*
+ * Copies the most recently generated sample without consuming anything;
+ * -ENODATA before the first one. Needs no read position of its own.
+ */
+#define SIMTEMP_IOC_GET_LATEST  _IOR(SIMTEMP_IOCTL_MAGIC, 0x06, struct simtemp_sample)
+
+/* mmap() page offsets; multiply by the system page size. */
+#define SIMTEMP_MMAP_PGOFF_READER  0
+#define SIMTEMP_MMAP_PGOFF_RING    1
+
+/**
+ * struct simtemp_ring_ctrl - read-only header of the shared ring mapping
+ * @head:        producer index (free running); published with release semantics
+ * @depth:       number of records in the ring (power of two)
+ * @record_size: size of one record (sizeof(struct simtemp_sample))
+ * @data_offset: byte offset of the first record from the start of the mapping
+ * @claim:       end of the slots the producer is writing; stored before the
+ *               records it covers, always at or ahead of @head
+ *
+ * Mapped at SIMTEMP_MMAP_PGOFF_RING, read-only and shared by every reader of
+ * the device. Record i lives at data_offset + (i & (depth - 1)) * record_size
+ * and is overwritten once the producer wraps around (under the default
+ * drop-oldest policy). The producer may write several records before moving
+ * @head, which is why overwrites are detected against @claim.
+ */
+struct simtemp_ring_ctrl {
+	__u32 head;
+	__u32 depth;
+	__u32 record_size;
+	__u32 data_offset;
+	__u32 claim;
+};
+
+/**
+ * struct simtemp_reader_ctrl - per open file cursor page
+ * @tail:     next index this reader will consume (free running)
+ * @overruns: records this reader lost because the producer lapped it
+ *
+ * Mapped read/write at SIMTEMP_MMAP_PGOFF_READER. Every open file has its own
+ * page, so each reader sees every sample. read() and poll() use @tail as the
+ * cursor; a mapped consumer loads @head with acquire semantics, copies records
+ * [@tail, @head), issues a read barrier and loads @claim: any copied
+ * index i with (claim - i) > depth may have been overwritten mid-copy and must
+ * be discarded (and counted in @overruns); a reader exactly @depth behind
+ * loses nothing. It then stores the new @tail with
+ * release semantics and only blocks in poll() once @tail equals @head.
+ */
+struct simtemp_reader_ctrl {
+	__u32 tail;
+	__u32 overruns;
+};
 #endif /* NXP_SIMTEMP_IOCTL_H */
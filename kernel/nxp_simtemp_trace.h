@@ -0,0 +1,166 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM nxp_simtemp
+
+#if !defined(NXP_SIMTEMP_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define NXP_SIMTEMP_TRACE_H
+
+#include "nxp_simtemp_ioctl.h"
+
+#include <linux/tracepoint.h>
+
+/*
+ * Data path tracepoints, all under events/nxp_simtemp/. Ring positions are
+ * the free-running u32 indices of struct simtemp_ring_ctrl; occupancy is
+ * head - tail as seen by the event's reader.
+ */
+
+/* One per generated sample, whether or not it made it into the ring. */
+TRACE_EVENT(simtemp_sample,
+	TP_PROTO(int id, const struct simtemp_sample *sample),
+	TP_ARGS(id, sample),
+
+	TP_STRUCT__entry(
+		__field(int, id)
+		__field(u64, seq)
+		__field(u64, timestamp_ns)
+		__field(s32, temp_mc)
+		__field(u32, flags)
+	),
+
+	TP_fast_assign(
+		__entry->id = id;
+		__entry->seq = sample->seq;
+		__entry->timestamp_ns = sample->timestamp_ns;
+		__entry->temp_mc = sample->temp_mc;
+		__entry->flags = sample->flags;
+	),
+
+	TP_printk("simtemp%d seq=%llu ts=%llu temp_mC=%d flags=0x%x",
+		  __entry->id, __entry->seq, __entry->timestamp_ns,
+		  __entry->temp_mc, __entry->flags)
+);
+
+/* One per tick that stored samples: the new head and what it cost. */
+TRACE_EVENT(simtemp_publish,
+	TP_PROTO(int id, u32 head, u32 count, u32 dropped, u32 depth),
+	TP_ARGS(id, head, count, dropped, depth),
+
+	TP_STRUCT__entry(
+		__field(int, id)
+		__field(u32, head)
+		__field(u32, count)
+		__field(u32, dropped)
+		__field(u32, depth)
+	),
+
+	TP_fast_assign(
+		__entry->id = id;
+		__entry->head = head;
+		__entry->count = count;
+		__entry->dropped = dropped;
+		__entry->depth = depth;
+	),
+
+	TP_printk("simtemp%d head=%u count=%u dropped=%u depth=%u",
+		  __entry->id, __entry->head, __entry->count,
+		  __entry->dropped, __entry->depth)
+);
+
+/* The slowest reader is a full ring behind (drop-newest and block). */
+TRACE_EVENT(simtemp_overflow,
+	TP_PROTO(int id, u32 head, u32 want, u32 room, u32 policy),
+	TP_ARGS(id, head, want, room, policy),
+
+	TP_STRUCT__entry(
+		__field(int, id)
+		__field(u32, head)
+		__field(u32, want)
+		__field(u32, room)
+		__field(u32, policy)
+	),
+
+	TP_fast_assign(
+		__entry->id = id;
+		__entry->head = head;
+		__entry->want = want;
+		__entry->room = room;
+		__entry->policy = policy;
+	),
+
+	TP_printk("simtemp%d head=%u want=%u room=%u policy=%u",
+		  __entry->id, __entry->head, __entry->want,
+		  __entry->room, __entry->policy)
+);
+
+/*
+ * One per raw read() batch. @lost counts samples the producer overwrote
+ * before this reader got to them (drop-oldest); @last is the newest sample
+ * handed out.
+ */
+TRACE_EVENT(simtemp_read,
+	TP_PROTO(int id, u32 head, u32 tail, u32 count, u32 lost,
+		 const struct simtemp_sample *last),
+	TP_ARGS(id, head, tail, count, lost, last),
+
+	TP_STRUCT__entry(
+		__field(int, id)
+		__field(u32, head)
+		__field(u32, tail)
+		__field(u32, count)
+		__field(u32, lost)
+		__field(u64, seq)
+		__field(u64, timestamp_ns)
+		__field(s32, temp_mc)
+	),
+
+	TP_fast_assign(
+		__entry->id = id;
+		__entry->head = head;
+		__entry->tail = tail;
+		__entry->count = count;
+		__entry->lost = lost;
+		__entry->seq = last->seq;
+		__entry->timestamp_ns = last->timestamp_ns;
+		__entry->temp_mc = last->temp_mc;
+	),
+
+	TP_printk("simtemp%d head=%u tail=%u occupancy=%u count=%u lost=%u seq=%llu ts=%llu temp_mC=%d",
+		  __entry->id, __entry->head, __entry->tail,
+		  __entry->head - __entry->tail, __entry->count,
+		  __entry->lost, __entry->seq, __entry->timestamp_ns,
+		  __entry->temp_mc)
+);
+
+/* One per poll() call on a file, with the readiness it reported. */
+TRACE_EVENT(simtemp_poll,
+	TP_PROTO(int id, u32 head, u32 tail, unsigned int mask),
+	TP_ARGS(id, head, tail, mask),
+
+	TP_STRUCT__entry(
+		__field(int, id)
+		__field(u32, head)
+		__field(u32, tail)
+		__field(unsigned int, mask)
+	),
+
+	TP_fast_assign(
+		__entry->id = id;
+		__entry->head = head;
+		__entry->tail = tail;
+		__entry->mask = mask;
+	),
+
+	TP_printk("simtemp%d head=%u tail=%u occupancy=%u mask=0x%x",
+		  __entry->id, __entry->head, __entry->tail,
+		  __entry->head - __entry->tail, __entry->mask)
+);
+
+#endif /* NXP_SIMTEMP_TRACE_H */
+
+/* This part must be outside the include guard. */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE nxp_simtemp_trace
+#include <trace/define_trace.h>
@@ -3,7 +3,7 @@ set -euo pipefail
 
 MODULE="kernel/nxp_simtemp.ko"
 SYSFS_ROOT="/sys/class/simtemp"
-CHARDEV="/dev/nxp_simtemp"
+CHARDEV="/dev/simtemp0"
 CLI="sudo python3 user/cli/main.py"
 MODULE_NAME="nxp_simtemp"
 MODULE_LOADED=0
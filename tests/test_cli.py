@@ -4,8 +4,12 @@ from __future__ import annotations
 
 import argparse
 import importlib.util
+import json
+import mmap
 import os
+import struct
 import sys
+import threading
 import time
 from pathlib import Path
 from typing import Any, List, Optional, Tuple, Union
@@ -73,6 +77,59 @@ def test_non_negative_int_boundary_invalid(value: str) -> None:
         cli.non_negative_int(value)
 
 
+@pytest.mark.parametrize(
+    ("fraction", "expected"),
+    [(0.0, 10), (0.5, 50), (0.99, 100), (0.999, 100), (1.0, 100)],
+)
+def test_percentile_nearest_rank(fraction: float, expected: int) -> None:
+    """percentile() uses nearest rank and clamps to the first and last values."""
+
+    values = list(range(10, 101, 10))
+    assert cli.percentile(values, fraction) == expected
+    assert cli.percentile([], fraction) is None
+
+
+def test_decode_samples_batches_and_drops_partial_record() -> None:
+    """decode_samples() splits a batched read and ignores a trailing partial record."""
+
+    records = [(1, 21000, 0x1, 7), (2, 46000, 0x3, 8), (3, 22000, 0x1, 9)]
+    data = b"".join(cli.SIMTEMP_SAMPLE_STRUCT.pack(*r) for r in records)
+
+    assert cli.decode_samples(data) == records
+    assert cli.decode_samples(data + b"\x00" * 5) == records
+    assert cli.decode_samples(b"") == []
+
+
+def test_decode_aggregates_batches_and_drops_partial_record() -> None:
+    """decode_aggregates() unpacks window summaries and drops the reserved field."""
+
+    records = [(10, 0, 21000, 23000, 22000, 4, 0x0), (20, 4, 22000, 47000, 30000, 4, 0x2)]
+    data = b"".join(cli.SIMTEMP_AGGREGATE_STRUCT.pack(*r, 0) for r in records)
+
+    assert cli.SIMTEMP_AGGREGATE_STRUCT.size == 40
+    assert cli.decode_aggregates(data + b"\x00" * 7) == records
+    assert cli.format_aggregate(records[1]).endswith(
+        "min=22.0C max=47.0C mean=30.0C n=4 alert=1 seq=4"
+    )
+
+
+def test_parse_stats_reads_name_value_pairs() -> None:
+    """parse_stats() turns the one-line `stats` attribute into a dict."""
+
+    stats = cli.parse_stats("updates=12 alerts=1 overwritten=3 bogus missed=0\n")
+    assert stats == {"updates": 12, "alerts": 1, "overwritten": 3, "missed": 0}
+
+
+@pytest.mark.parametrize(
+    ("prev_seq", "seq", "expected"),
+    [(None, 5, 0), (4, 5, 0), (4, 8, 3), (9, 2, 0)],
+)
+def test_sequence_gap(prev_seq: Optional[int], seq: int, expected: int) -> None:
+    """sequence_gap() counts samples skipped between consecutive records."""
+
+    assert cli.sequence_gap(prev_seq, seq) == expected
+
+
 # ---------------------------------------------------------------------------
 # White-box tests (exercise internal behaviour of SimtempDevice helpers)
 # ---------------------------------------------------------------------------
@@ -130,6 +187,38 @@ def test_simtemp_device_chooses_sorted_entry(tmp_path: Path) -> None:
     assert second.sysfs_dir == dev1
 
 
+def test_simtemp_device_numeric_order_and_default_char_device(tmp_path: Path) -> None:
+    """Instances sort by their numeric suffix and map to /dev/simtempN by default."""
+
+    for n in (10, 2, 1):
+        devdir = tmp_path / f"simtemp{n}"
+        devdir.mkdir()
+        _write_attrs(devdir, sampling=100, threshold=45000, mode="normal")
+
+    picked = [cli.SimtempDevice(tmp_path, index=i, device_path=None) for i in range(3)]
+    assert [d.sysfs_dir.name for d in picked] == ["simtemp1", "simtemp2", "simtemp10"]
+    assert picked[2].char_device == Path("/dev/simtemp10")
+
+    explicit = cli.SimtempDevice(tmp_path, index=0, device_path=Path("/dev/fake"))
+    assert explicit.char_device == Path("/dev/fake")
+
+
+def test_clock_offset_follows_timestamp_clock(tmp_path: Path) -> None:
+    """Timestamps are shifted onto wall time according to timestamp_clock."""
+
+    root = tmp_path / "simtemp"
+    device_dir = root / "simtemp0"
+    device_dir.mkdir(parents=True)
+    device = cli.SimtempDevice(root, 0, None)
+
+    # Attribute missing: older kernels stamped with CLOCK_REALTIME.
+    assert device.clock_offset_ns() == 0
+
+    (device_dir / "timestamp_clock").write_text("monotonic\n")
+    expected = time.time_ns() - time.monotonic_ns()
+    assert abs(device.clock_offset_ns() - expected) < 1_000_000_000
+
+
 def test_write_sampling_prefers_microseconds(tmp_path: Path) -> None:
     sysfs_root = tmp_path
     devdir = sysfs_root / "simtemp0"
@@ -182,6 +271,7 @@ def test_wait_for_alert_success(monkeypatch: pytest.MonkeyPatch) -> None:
         1234567890,
         42000,
         cli.SIMTEMP_FLAG_ALERT,
+        0,
     )
     reads = [sample_bytes]
 
@@ -220,7 +310,7 @@ def test_wait_for_alert_success(monkeypatch: pytest.MonkeyPatch) -> None:
     success, sample, count = cli.wait_for_alert(Path("/dev/nxp_simtemp"), sampling_us=100_000, max_periods=1)
     assert success is True
     assert count == 1
-    assert sample == (1234567890, 42000, cli.SIMTEMP_FLAG_ALERT)
+    assert sample == (1234567890, 42000, cli.SIMTEMP_FLAG_ALERT, 0)
     assert opened[0] == Path("/dev/nxp_simtemp")
 
 
@@ -259,6 +349,64 @@ def test_wait_for_alert_timeout(monkeypatch: pytest.MonkeyPatch) -> None:
     assert count == 0
 
 
+def test_bench_run_measures_rate_gaps_and_latency(monkeypatch: pytest.MonkeyPatch, tmp_path: Path) -> None:
+    """bench_run() configures the device, then reports rate, gaps, latency and CPU time."""
+
+    devdir = tmp_path / "simtemp0"
+    devdir.mkdir()
+    _write_attrs(devdir, sampling=100, threshold=45000, mode="normal")
+    (devdir / "burst").write_text("2\n")
+    (devdir / "stats").write_text("updates=10 overwritten=0 missed=1 overflows=0 wakeups=5\n")
+    device = cli.SimtempDevice(tmp_path, 0, Path("/dev/fake"))
+
+    fd = 77
+    reads = [
+        b"".join(cli.SIMTEMP_SAMPLE_STRUCT.pack(ts, 45000, 0x1, seq) for ts, seq in [(1000, 0), (2000, 1)]),
+        cli.SIMTEMP_SAMPLE_STRUCT.pack(3000, 45000, 0x1, 4),
+    ]
+
+    def fake_read(handle: int, size: int) -> bytes:
+        assert handle == fd
+        assert size == cli.SIMTEMP_SAMPLE_STRUCT.size * 8
+        return reads.pop(0) if reads else b""
+
+    class ReadyPoll:
+        def register(self, handle: int, events: int) -> None:
+            assert events == cli.select.POLLIN
+
+        def poll(self, timeout: int) -> List[Tuple[int, int]]:
+            return [(fd, cli.select.POLLIN)]
+
+    ticks = [0.0]
+
+    def fake_monotonic() -> float:
+        ticks[0] += 0.25
+        return ticks[0]
+
+    cpu = [0, 500_000_000]
+    monkeypatch.setattr(os, "open", lambda path, flags: fd)
+    monkeypatch.setattr(os, "close", lambda _: None)
+    monkeypatch.setattr(os, "read", fake_read)
+    monkeypatch.setattr(cli.select, "poll", ReadyPoll)
+    monkeypatch.setattr(cli.time, "monotonic", fake_monotonic)
+    monkeypatch.setattr(cli.time, "clock_gettime_ns", lambda clock_id: 5000)
+    monkeypatch.setattr(cli.time, "process_time_ns", lambda: cpu.pop(0))
+
+    run = cli.bench_run(device, sampling_us=1000, mode="noisy", duration=1.0, batch=8)
+
+    assert (devdir / "sampling_us").read_text().strip() == "1000"
+    assert (devdir / "mode").read_text().strip() == "noisy"
+    assert run["samples"] == 3
+    assert run["gaps"] == 2
+    assert run["duration_s"] == 1.25
+    assert run["rate_hz"] == 2.4
+    assert run["expected_hz"] == 2000.0
+    assert run["latency_ns"] == {"p50": 3000, "p99": 4000, "p999": 4000, "max": 4000}
+    assert run["stats"] == {"overwritten": 0, "missed": 0, "overflows": 0, "wakeups": 0}
+    assert run["cpu_s"] == 0.5
+    assert run["cpu_pct"] == 40.0
+
+
 # ---------------------------------------------------------------------------
 # Black-box tests (exercise CLI entry points via main())
 # ---------------------------------------------------------------------------
@@ -282,11 +430,14 @@ def test_main_test_command_success(monkeypatch: pytest.MonkeyPatch, capsys: pyte
         def snapshot(self) -> cli.SimtempConfig:
             return cli.SimtempConfig(sampling_us=100_000, threshold_mc=46000, mode="normal")
 
+        def clock_offset_ns(self) -> int:
+            return 0
+
     monkeypatch.setattr(cli, "SimtempDevice", FakeDevice)
     monkeypatch.setattr(
         cli,
         "wait_for_alert",
-        lambda *_args, **_kwargs: (True, (111, 47000, cli.SIMTEMP_FLAG_ALERT), 1),
+        lambda *_args, **_kwargs: (True, (111, 47000, cli.SIMTEMP_FLAG_ALERT, 0), 1),
     )
 
     rc = cli.main(["test", "--max-periods", "1"])
@@ -315,3 +466,144 @@ def test_main_handles_device_errors(monkeypatch: pytest.MonkeyPatch, capsys: pyt
     captured = capsys.readouterr().err
     assert excinfo.value.code == 2  # argparse exits with code 2 on parser errors
     assert "sysfs root missing" in captured
+
+
+def test_main_bench_sweeps_and_writes_json(monkeypatch: pytest.MonkeyPatch, tmp_path: Path) -> None:
+    """`bench` runs every sampling/mode pair, writes a JSON report and restores the device."""
+
+    writes: List[Tuple[str, str]] = []
+    runs: List[Tuple[int, str]] = []
+
+    class FakeDevice:
+        def __init__(self, sysfs_root: Path, index: int, device_path: Optional[Path]) -> None:
+            self.sysfs_dir = Path("/sys/class/simtemp/simtemp3")
+            self.char_device = Path("/dev/simtemp3")
+
+        def write(self, name: str, value: str) -> None:
+            writes.append((name, value))
+
+        def snapshot(self) -> cli.SimtempConfig:
+            return cli.SimtempConfig(sampling_us=100_000, threshold_mc=45000, mode="ramp")
+
+        def timestamp_clock(self) -> str:
+            return "monotonic"
+
+    def fake_bench_run(device: Any, *, sampling_us: int, mode: str, duration: float, batch: int) -> dict[str, Any]:
+        assert duration == 0.5
+        assert batch == cli.DEFAULT_BENCH_BATCH
+        runs.append((sampling_us, mode))
+        return {"sampling_us": sampling_us, "mode": mode, "rate_hz": 1.0, "expected_hz": 1.0,
+                "gaps": 0, "latency_ns": {"p99": 1}, "cpu_pct": 0.0}
+
+    monkeypatch.setattr(cli, "SimtempDevice", FakeDevice)
+    monkeypatch.setattr(cli, "bench_run", fake_bench_run)
+
+    output = tmp_path / "bench.json"
+    rc = cli.main(["bench", "--sampling-us", "500,100", "--modes", "normal,sine", "--duration", "0.5",
+                   "--output", str(output)])
+
+    assert rc == 0
+    assert runs == [(500, "normal"), (500, "sine"), (100, "normal"), (100, "sine")]
+    report = json.loads(output.read_text())
+    assert report["device"] == "simtemp3"
+    assert report["timestamp_clock"] == "monotonic"
+    assert [(r["sampling_us"], r["mode"]) for r in report["runs"]] == runs
+    assert writes == [("sampling_us", "100000"), ("mode", "ramp")]
+
+
+def test_main_bench_rejects_unknown_mode(capsys: pytest.CaptureFixture[str]) -> None:
+    """`bench --modes` validates every entry before touching the device."""
+
+    with pytest.raises(SystemExit) as excinfo:
+        cli.main(["bench", "--modes", "normal,bogus"])
+
+    assert excinfo.value.code == 2
+    assert "unknown mode 'bogus'" in capsys.readouterr().err
+
+
+# ---------------------------------------------------------------------------
+# Integration tests (need a loaded driver; skipped otherwise)
+# ---------------------------------------------------------------------------
+
+LIVE_DEVICE = Path("/dev/simtemp0")
+
+
+@pytest.mark.skipif(
+    not os.access(LIVE_DEVICE, os.R_OK),
+    reason="needs a readable /dev/simtemp0 (load nxp_simtemp, run as root)",
+)
+def test_blocking_readers_sharing_a_file_never_see_eagain() -> None:
+    """Two threads blocked in read() on one file both get data, never EAGAIN.
+
+    Exclusive wakeups may wake both for one batch; the loser must go back to
+    sleep instead of failing a read that did not ask for O_NONBLOCK.
+    """
+
+    reads_per_thread = 10
+    fd = os.open(LIVE_DEVICE, os.O_RDONLY)
+    errors: List[BaseException] = []
+    counts = [0, 0]
+
+    def worker(slot: int) -> None:
+        try:
+            for _ in range(reads_per_thread):
+                data = os.read(fd, cli.SIMTEMP_SAMPLE_STRUCT.size)
+                assert len(data) == cli.SIMTEMP_SAMPLE_STRUCT.size
+                counts[slot] += 1
+        except BaseException as exc:  # BlockingIOError is the regression
+            errors.append(exc)
+
+    threads = [threading.Thread(target=worker, args=(slot,)) for slot in range(2)]
+    try:
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join(timeout=60)
+    finally:
+        os.close(fd)
+
+    assert not any(thread.is_alive() for thread in threads)
+    assert errors == []
+    assert counts == [reads_per_thread, reads_per_thread]
+
+
+LIVE_SYSFS = Path("/sys/class/simtemp/simtemp0")
+
+
+@pytest.mark.skipif(
+    not (os.access(LIVE_DEVICE, os.R_OK) and os.access(LIVE_SYSFS / "overflow_policy", os.W_OK)),
+    reason="needs /dev/simtemp0 and writable sysfs attributes (load nxp_simtemp, run as root)",
+)
+def test_block_reader_one_ring_behind_loses_nothing() -> None:
+    """Under `block`, a reader exactly one ring behind keeps every sample.
+
+    The producer fills all ring_depth slots and stalls; the reader must then
+    drain them without a seq gap and without counting an overrun.
+    """
+
+    device = cli.SimtempDevice(LIVE_SYSFS.parent, 0, LIVE_DEVICE)
+    saved = {name: device.read_str(name) for name in ("overflow_policy", "ring_depth", "sampling_us")}
+    try:
+        device.write("ring_depth", "16")
+        device.write("sampling_us", "1000")
+        device.write("overflow_policy", "block")
+        depth = device.read_int("ring_depth")
+
+        fd = os.open(LIVE_DEVICE, os.O_RDONLY | os.O_NONBLOCK)
+        try:
+            cursor = mmap.mmap(fd, mmap.PAGESIZE, mmap.MAP_SHARED, mmap.PROT_READ)
+            # Let the producer fill the ring and stall on this reader.
+            time.sleep(depth * 1000 / cli.MICROS_PER_SEC * 20)
+            records = cli.decode_samples(os.read(fd, cli.SIMTEMP_SAMPLE_STRUCT.size * depth))
+            _, overruns = struct.unpack_from("<II", cursor, 0)
+            cursor.close()
+        finally:
+            os.close(fd)
+    finally:
+        for name, value in saved.items():
+            device.write(name, value)
+
+    seqs = [seq for _, _, _, seq in records]
+    assert len(seqs) == depth
+    assert seqs == list(range(seqs[0], seqs[0] + depth))
+    assert overruns == 0
@@ -4,8 +4,10 @@
 Provides: 
   * stream – configure the device and print samples until interrupted (default)
   * test   – lower the threshold and ensure an alert fires within a few periods
+  * bench  – sweep sampling periods and modes, report rate/loss/latency as JSON
 
-All configuration is performed via sysfs; samples are read from `/dev/nxp_simtemp`.
+All configuration is performed via sysfs; samples are read from `/dev/simtempN`,
+where N matches the `/sys/class/simtemp/simtempN` directory.
 Run as root (or with sudo) so writes to sysfs and reads from the character device
 succeed.
 """
@@ -14,23 +16,48 @@ from __future__ import annotations
 
 import argparse
 import datetime as _dt
+import fcntl
+import json
+import math
 import os
+import platform
 import select
 import struct
 import sys
 import time
 from dataclasses import dataclass
 from pathlib import Path
-from typing import Optional
+from typing import Any, Optional
 
-SIMTEMP_SAMPLE_STRUCT = struct.Struct("<QiI")
+SIMTEMP_SAMPLE_STRUCT = struct.Struct("<QiIQ")
+SIMTEMP_AGGREGATE_STRUCT = struct.Struct("<QQiiiIII")
 SIMTEMP_FLAG_ALERT = 1 << 1
-DEFAULT_CHAR_DEVICE = Path("/dev/nxp_simtemp")
+SIMTEMP_STREAM_AGGREGATE = 1
+# _IOW('t', 0x05, __u32) with the generic Linux ioctl encoding.
+SIMTEMP_IOC_SET_STREAM = (1 << 30) | (4 << 16) | (ord("t") << 8) | 0x05
+DEFAULT_DEV_ROOT = Path("/dev")
 DEFAULT_SYSFS_ROOT = Path("/sys/class/simtemp")
 DEFAULT_TEST_THRESHOLD_MC = 20000
 DEFAULT_TEST_MAX_PERIODS = 2
 DEFAULT_POLL_TIMEOUT_MS = 1000
+DEFAULT_READ_BATCH = 64
+DEFAULT_BENCH_SAMPLING_US = [1000, 100]
+DEFAULT_BENCH_MODES = ["normal"]
+DEFAULT_BENCH_DURATION_S = 5.0
+DEFAULT_BENCH_BATCH = 256
+# Device-wide counters reported as deltas over each bench run.
+BENCH_STATS = ["overwritten", "missed", "overflows", "wakeups"]
 MICROS_PER_SEC = 1_000_000
+MODES = ["normal", "noisy", "ramp", "replay", "sine", "square", "sawtooth", "step"]
+# timestamp_clock names mapped to Linux clockid_t values.
+SIMTEMP_CLOCK_IDS = {
+    "realtime": 0,
+    "monotonic": 1,
+    "monotonic-raw": 4,
+    "realtime-coarse": 5,
+    "monotonic-coarse": 6,
+    "boottime": 7,
+}
 
 
 @dataclass
@@ -40,6 +67,13 @@ class SimtempConfig:
     mode: str
 
 
+def _instance_key(path: Path) -> tuple[int, str]:
+    """Order simtempN directories numerically so simtemp10 follows simtemp9."""
+
+    suffix = path.name[len("simtemp"):]
+    return (int(suffix) if suffix.isdigit() else sys.maxsize, path.name)
+
+
 class SimtempDevice:
     """Helper that abstracts sysfs access for a single simtemp instance."""
 
@@ -47,14 +81,14 @@ class SimtempDevice:
         if not sysfs_root.exists():
             raise FileNotFoundError(f"sysfs root {sysfs_root} does not exist")
 
-        devices = sorted(p for p in sysfs_root.glob("simtemp*") if p.is_dir())
+        devices = sorted((p for p in sysfs_root.glob("simtemp*") if p.is_dir()), key=_instance_key)
         if not devices:
             raise FileNotFoundError(f"no simtemp devices under {sysfs_root}")
         if index < 0 or index >= len(devices):
             raise IndexError(f"requested device index {index} out of range (0-{len(devices)-1})")
 
         self.sysfs_dir = devices[index]
-        self.char_device = device_path or DEFAULT_CHAR_DEVICE
+        self.char_device = device_path or DEFAULT_DEV_ROOT / self.sysfs_dir.name
 
     def _attr_path(self, name: str) -> Path:
         return self.sysfs_dir / name
@@ -68,6 +102,18 @@ class SimtempDevice:
     def write(self, name: str, value: str) -> None:
         self._attr_path(name).write_text(f"{value}\n")
 
+    def timestamp_clock(self) -> str:
+        try:
+            return self.read_str("timestamp_clock")
+        except FileNotFoundError:
+            # Older kernels always stamped with CLOCK_REALTIME.
+            return "realtime"
+
+    def clock_offset_ns(self) -> int:
+        """Offset that turns this device's timestamps into wall-clock time."""
+
+        return clock_offset_ns(self.timestamp_clock())
+
     def snapshot(self) -> SimtempConfig:
         try:
             sampling_us = self.read_int("sampling_us")
@@ -81,11 +127,76 @@ class SimtempDevice:
         )
 
 
+def clock_offset_ns(clock: str) -> int:
+    """CLOCK_REALTIME minus the named clock, sampled once."""
+
+    clock_id = SIMTEMP_CLOCK_IDS[clock]
+    if clock_id == SIMTEMP_CLOCK_IDS["realtime"]:
+        return 0
+    return time.time_ns() - time.clock_gettime_ns(clock_id)
+
+
 def iso8601_from_ns(ns: int) -> str:
     dt = _dt.datetime.fromtimestamp(ns / 1_000_000_000, tz=_dt.timezone.utc)
     return dt.isoformat(timespec="milliseconds")
 
 
+def decode_samples(data: bytes) -> list[tuple[int, int, int, int]]:
+    """Split a batched read() into (timestamp_ns, temp_mc, flags, seq) tuples.
+
+    Trailing bytes that do not form a whole record are ignored.
+    """
+
+    usable = len(data) - (len(data) % SIMTEMP_SAMPLE_STRUCT.size)
+    return list(SIMTEMP_SAMPLE_STRUCT.iter_unpack(data[:usable]))
+
+
+def decode_aggregates(data: bytes) -> list[tuple[int, int, int, int, int, int, int]]:
+    """Split an aggregate-stream read() into
+    (timestamp_ns, first_seq, min_mc, max_mc, mean_mc, count, flags) tuples.
+    """
+
+    usable = len(data) - (len(data) % SIMTEMP_AGGREGATE_STRUCT.size)
+    return [record[:7] for record in SIMTEMP_AGGREGATE_STRUCT.iter_unpack(data[:usable])]
+
+
+def format_aggregate(record: tuple[int, int, int, int, int, int, int], offset_ns: int = 0) -> str:
+    timestamp_ns, first_seq, min_mc, max_mc, mean_mc, count, flags = record
+    alert = 1 if flags & SIMTEMP_FLAG_ALERT else 0
+    return (
+        f"{iso8601_from_ns(timestamp_ns + offset_ns)} min={min_mc / 1000.0:.1f}C max={max_mc / 1000.0:.1f}C "
+        f"mean={mean_mc / 1000.0:.1f}C n={count} alert={alert} seq={first_seq}"
+    )
+
+
+def sequence_gap(prev_seq: Optional[int], seq: int) -> int:
+    """Number of samples lost between two consecutive records (0 if none)."""
+
+    if prev_seq is None or seq <= prev_seq:
+        return 0
+    return seq - prev_seq - 1
+
+
+def parse_stats(text: str) -> dict[str, int]:
+    """Parse the `stats` attribute (`name=value` pairs on one line)."""
+
+    stats = {}
+    for field in text.split():
+        name, sep, value = field.partition("=")
+        if sep and value.isdigit():
+            stats[name] = int(value)
+    return stats
+
+
+def percentile(sorted_values: list[int], fraction: float) -> Optional[int]:
+    """Nearest-rank percentile of an ascending list (None when empty)."""
+
+    if not sorted_values:
+        return None
+    rank = min(max(math.ceil(len(sorted_values) * fraction), 1), len(sorted_values))
+    return sorted_values[rank - 1]
+
+
 def write_sampling(device: SimtempDevice, *, sampling_us: Optional[int], sampling_ms: Optional[int]) -> None:
     if sampling_us is not None:
         try:
@@ -106,15 +217,23 @@ def stream_command(args: argparse.Namespace) -> int:
         device.write("threshold_mC", str(args.threshold_mc))
     if args.mode is not None:
         device.write("mode", args.mode)
+    if args.window is not None:
+        device.write("agg_window", str(args.window))
+    record_size = SIMTEMP_AGGREGATE_STRUCT.size if args.window else SIMTEMP_SAMPLE_STRUCT.size
+    offset_ns = device.clock_offset_ns()
 
     count_limit = args.count
     deadline = time.monotonic() + args.duration if args.duration else None
 
     fd = os.open(device.char_device, os.O_RDONLY | os.O_NONBLOCK)
+    if args.window:
+        fcntl.ioctl(fd, SIMTEMP_IOC_SET_STREAM, struct.pack("<I", SIMTEMP_STREAM_AGGREGATE))
     poller = select.poll()
-    poller.register(fd, select.POLLIN | select.POLLPRI)
+    poller.register(fd, select.POLLIN)
 
     samples = 0
+    lost = 0
+    prev_seq: Optional[int] = None
     try:
         while True:
             if deadline is not None and time.monotonic() >= deadline:
@@ -126,31 +245,45 @@ def stream_command(args: argparse.Namespace) -> int:
             if not events:
                 continue
 
+            batch = DEFAULT_READ_BATCH
+            if count_limit is not None:
+                batch = min(batch, count_limit - samples)
             try:
-                data = os.read(fd, SIMTEMP_SAMPLE_STRUCT.size)
+                data = os.read(fd, record_size * batch)
             except BlockingIOError:
                 continue
-            if len(data) < SIMTEMP_SAMPLE_STRUCT.size:
-                continue
 
-            timestamp_ns, temp_mc, flags = SIMTEMP_SAMPLE_STRUCT.unpack(data)
-            ts = iso8601_from_ns(timestamp_ns)
-            temp_c = temp_mc / 1000.0
-            alert = 1 if flags & SIMTEMP_FLAG_ALERT else 0
-            print(f"{ts} temp={temp_c:.1f}C alert={alert} flags=0x{flags:02x}")
-            samples += 1
+            lines = []
+            if args.window:
+                lines.extend(format_aggregate(record, offset_ns) for record in decode_aggregates(data))
+            else:
+                for timestamp_ns, temp_mc, flags, seq in decode_samples(data):
+                    gap = sequence_gap(prev_seq, seq)
+                    if gap:
+                        lost += gap
+                        print(f"# gap: {gap} sample(s) lost before seq={seq}", file=sys.stderr)
+                    prev_seq = seq
+                    ts = iso8601_from_ns(timestamp_ns + offset_ns)
+                    temp_c = temp_mc / 1000.0
+                    alert = 1 if flags & SIMTEMP_FLAG_ALERT else 0
+                    lines.append(f"{ts} temp={temp_c:.1f}C alert={alert} flags=0x{flags:02x} seq={seq}")
+            if lines:
+                print("\n".join(lines))
+                samples += len(lines)
     except KeyboardInterrupt:
         pass
     finally:
         os.close(fd)
 
+    if lost:
+        print(f"# {lost} sample(s) lost in total", file=sys.stderr)
     return 0
 
 
-def wait_for_alert(char_device: Path, sampling_us: int, max_periods: int) -> tuple[bool, Optional[tuple[int, int, int]], int]:
+def wait_for_alert(char_device: Path, sampling_us: int, max_periods: int) -> tuple[bool, Optional[tuple[int, int, int, int]], int]:
     fd = os.open(char_device, os.O_RDONLY | os.O_NONBLOCK)
     poller = select.poll()
-    poller.register(fd, select.POLLIN | select.POLLPRI)
+    poller.register(fd, select.POLLIN)
 
     timeout_s = max_periods * sampling_us / MICROS_PER_SEC
     deadline = time.monotonic() + max(timeout_s, 0.5)
@@ -169,7 +302,7 @@ def wait_for_alert(char_device: Path, sampling_us: int, max_periods: int) -> tup
                 continue
             samples += 1
             unpacked = SIMTEMP_SAMPLE_STRUCT.unpack(data)
-            _, _, flags = unpacked
+            _, _, flags, _ = unpacked
             if flags & SIMTEMP_FLAG_ALERT:
                 return True, unpacked, samples
         return False, None, samples
@@ -204,8 +337,8 @@ def test_command(args: argparse.Namespace) -> int:
         )
 
         if success and sample is not None:
-            ts_ns, temp_mc, flags = sample
-            ts = iso8601_from_ns(ts_ns)
+            ts_ns, temp_mc, flags, _ = sample
+            ts = iso8601_from_ns(ts_ns + device.clock_offset_ns())
             temp_c = temp_mc / 1000.0
             print(f"PASS: alert observed after {count} sample(s) at {ts} temp={temp_c:.1f}C flags=0x{flags:02x}")
             return 0
@@ -223,6 +356,121 @@ def test_command(args: argparse.Namespace) -> int:
             device.write("mode", original.mode)
 
 
+def read_stats(device: SimtempDevice) -> dict[str, int]:
+    try:
+        return parse_stats(device.read_str("stats"))
+    except FileNotFoundError:
+        return {}
+
+
+def bench_run(device: SimtempDevice, *, sampling_us: int, mode: str, duration: float, batch: int) -> dict[str, Any]:
+    """Consume the raw stream for `duration` seconds and summarise it.
+
+    Latency is the sample age at read() time on the device's own clock, so it
+    covers producer-to-wakeup delay plus read batching. CPU time is this
+    process only (user + system).
+    """
+
+    write_sampling(device, sampling_us=sampling_us, sampling_ms=None)
+    device.write("mode", mode)
+    clock_id = SIMTEMP_CLOCK_IDS[device.timestamp_clock()]
+    try:
+        burst = device.read_int("burst")
+    except FileNotFoundError:
+        burst = 1
+
+    fd = os.open(device.char_device, os.O_RDONLY | os.O_NONBLOCK)
+    poller = select.poll()
+    poller.register(fd, select.POLLIN)
+
+    latencies: list[int] = []
+    samples = 0
+    gaps = 0
+    prev_seq: Optional[int] = None
+    before = read_stats(device)
+    cpu_start = time.process_time_ns()
+    start = time.monotonic()
+    deadline = start + duration
+    try:
+        while True:
+            now = time.monotonic()
+            if now >= deadline:
+                break
+            if not poller.poll(max(int((deadline - now) * 1000), 1)):
+                continue
+            try:
+                data = os.read(fd, SIMTEMP_SAMPLE_STRUCT.size * batch)
+            except BlockingIOError:
+                continue
+            read_ns = time.clock_gettime_ns(clock_id)
+            for timestamp_ns, _, _, seq in decode_samples(data):
+                gaps += sequence_gap(prev_seq, seq)
+                prev_seq = seq
+                latencies.append(read_ns - timestamp_ns)
+                samples += 1
+        elapsed = time.monotonic() - start
+        cpu_ns = time.process_time_ns() - cpu_start
+    finally:
+        os.close(fd)
+    after = read_stats(device)
+
+    latencies.sort()
+    return {
+        "sampling_us": sampling_us,
+        "mode": mode,
+        "duration_s": round(elapsed, 3),
+        "samples": samples,
+        "rate_hz": round(samples / elapsed, 1) if elapsed > 0 else 0.0,
+        "expected_hz": round(MICROS_PER_SEC * burst / sampling_us, 1),
+        "gaps": gaps,
+        "stats": {name: after[name] - before[name] for name in BENCH_STATS if name in before and name in after},
+        "latency_ns": {
+            "p50": percentile(latencies, 0.50),
+            "p99": percentile(latencies, 0.99),
+            "p999": percentile(latencies, 0.999),
+            "max": latencies[-1] if latencies else None,
+        },
+        "cpu_s": round(cpu_ns / 1e9, 3),
+        "cpu_pct": round(100.0 * cpu_ns / 1e9 / elapsed, 1) if elapsed > 0 else 0.0,
+    }
+
+
+def bench_command(args: argparse.Namespace) -> int:
+    device = SimtempDevice(args.sysfs_root, args.index, args.device)
+    original = device.snapshot()
+
+    runs = []
+    try:
+        for sampling_us in args.sampling_us:
+            for mode in args.modes:
+                run = bench_run(device, sampling_us=sampling_us, mode=mode, duration=args.duration, batch=args.batch)
+                runs.append(run)
+                print(
+                    f"# sampling_us={sampling_us} mode={mode} rate={run['rate_hz']}/s "
+                    f"(expected {run['expected_hz']}/s) gaps={run['gaps']} "
+                    f"p99={run['latency_ns']['p99']}ns cpu={run['cpu_pct']}%",
+                    file=sys.stderr,
+                )
+    finally:
+        write_sampling(device, sampling_us=original.sampling_us, sampling_ms=None)
+        device.write("mode", original.mode)
+
+    report = {
+        "device": device.sysfs_dir.name,
+        "kernel": platform.release(),
+        "machine": platform.machine(),
+        "timestamp_clock": device.timestamp_clock(),
+        "batch": args.batch,
+        "runs": runs,
+    }
+    text = json.dumps(report, indent=2)
+    if args.output is not None:
+        args.output.write_text(text + "\n")
+    else:
+        print(text)
+    return 0
+
+
 def positive_int(value: str) -> int:
     ivalue = int(value)
     if ivalue <= 0:
@@ -237,6 +485,25 @@ def non_negative_int(value: str) -> int:
     return ivalue
 
 
+def positive_int_list(value: str) -> list[int]:
+    return [positive_int(item) for item in value.split(",") if item]
+
+
+def mode_list(value: str) -> list[str]:
+    modes = [item for item in value.split(",") if item]
+    for mode in modes:
+        if mode not in MODES:
+            raise argparse.ArgumentTypeError(f"unknown mode '{mode}' (choose from {', '.join(MODES)})")
+    return modes
+
+
+def positive_float(value: str) -> float:
+    fvalue = float(value)
+    if fvalue <= 0:
+        raise argparse.ArgumentTypeError("value must be > 0")
+    return fvalue
+
+
 def build_parser() -> argparse.ArgumentParser:
     parser = argparse.ArgumentParser(description="nxp_simtemp CLI")
     parser.add_argument(
@@ -249,7 +516,7 @@ def build_parser() -> argparse.ArgumentParser:
         "--device",
         type=Path,
         default=None,
-        help="Character device to read (default: /dev/nxp_simtemp)",
+        help="Character device to read (default: /dev/simtempN matching --index)",
     )
     parser.add_argument(
         "--index",
@@ -271,7 +538,13 @@ def build_parser() -> argparse.ArgumentParser:
     stream.add_argument("--sampling-ms", type=positive_int, default=None, help="Update sampling period")
     stream.add_argument("--sampling-us", type=positive_int, default=None, help="Update sampling period in microseconds")
     stream.add_argument("--threshold-mc", type=int, default=None, help="Update threshold in milli °C")
-    stream.add_argument("--mode", choices=["normal", "noisy", "ramp"], default=None, help="Select mode")
+    stream.add_argument("--mode", choices=MODES, default=None, help="Select mode")
+    stream.add_argument(
+        "--window",
+        type=positive_int,
+        default=None,
+        help="Print per-window min/max/mean over N samples instead of raw samples",
+    )
     stream.set_defaults(func=stream_command)
 
     test = subparsers.add_parser("test", help="Run threshold alert self-test")
@@ -283,7 +556,7 @@ def build_parser() -> argparse.ArgumentParser:
         default=None,
         help=f"Threshold to use during the test (default: {DEFAULT_TEST_THRESHOLD_MC})",
     )
-    test.add_argument("--mode", choices=["normal", "noisy", "ramp"], default=None, help="Optional mode override")
+    test.add_argument("--mode", choices=MODES, default=None, help="Optional mode override")
     test.add_argument(
         "--max-periods",
         type=positive_int,
@@ -292,6 +565,34 @@ def build_parser() -> argparse.ArgumentParser:
     )
     test.set_defaults(func=test_command)
 
+    bench = subparsers.add_parser("bench", help="Measure rate, loss, latency and CPU cost; print JSON")
+    bench.add_argument(
+        "--sampling-us",
+        type=positive_int_list,
+        default=DEFAULT_BENCH_SAMPLING_US,
+        help="Comma-separated sampling periods to sweep (default: 1000,100)",
+    )
+    bench.add_argument(
+        "--modes",
+        type=mode_list,
+        default=DEFAULT_BENCH_MODES,
+        help="Comma-separated modes to sweep (default: normal)",
+    )
+    bench.add_argument(
+        "--duration",
+        type=positive_float,
+        default=DEFAULT_BENCH_DURATION_S,
+        help=f"Seconds per run (default: {DEFAULT_BENCH_DURATION_S:g})",
+    )
+    bench.add_argument(
+        "--batch",
+        type=positive_int,
+        default=DEFAULT_BENCH_BATCH,
+        help=f"Records per read() (default: {DEFAULT_BENCH_BATCH})",
+    )
+    bench.add_argument("--output", type=Path, default=None, help="Write the JSON report here instead of stdout")
+    bench.set_defaults(func=bench_command)
+
     parser.set_defaults(func=stream_command)
     return parser
 
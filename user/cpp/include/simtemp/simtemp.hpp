@@ -0,0 +1,186 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Native client for nxp_simtemp: sysfs configuration, batched reads of
+ * struct simtemp_sample into a buffer owned by the reader, and an epoll loop
+ * that drains many devices from one thread. Nothing is allocated per sample;
+ * buffers are sized once when a reader is constructed.
+ *
+ * Errors from the kernel surface as std::system_error carrying errno, the
+ * way OSError does in user/cli/main.py.
+ */
+#ifndef SIMTEMP_SIMTEMP_HPP
+#define SIMTEMP_SIMTEMP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <sys/epoll.h>
+
+#include "nxp_simtemp_ioctl.h"
+
+namespace simtemp {
+
+constexpr const char *kDefaultSysfsRoot = "/sys/class/simtemp";
+constexpr const char *kDefaultDevRoot = "/dev";
+constexpr std::size_t kDefaultReadBatch = 64;
+
+static_assert(sizeof(simtemp_sample) == 24, "simtemp_sample ABI changed");
+static_assert(sizeof(simtemp_aggregate) == 40, "simtemp_aggregate ABI changed");
+
+/* Owns one file descriptor and closes it on destruction. Move-only. */
+class FileDescriptor {
+public:
+	FileDescriptor() = default;
+	explicit FileDescriptor(int fd) : fd_(fd) {}
+	~FileDescriptor() { reset(); }
+
+	FileDescriptor(const FileDescriptor &) = delete;
+	FileDescriptor &operator=(const FileDescriptor &) = delete;
+	FileDescriptor(FileDescriptor &&other) noexcept : fd_(other.release()) {}
+	FileDescriptor &operator=(FileDescriptor &&other) noexcept;
+
+	int get() const { return fd_; }
+	explicit operator bool() const { return fd_ >= 0; }
+	int release();
+	void reset(int fd = -1);
+
+private:
+	int fd_ = -1;
+};
+
+/* Subset of the sysfs configuration the tools save and restore. */
+struct Config {
+	std::uint32_t sampling_us;
+	std::int32_t threshold_mc;
+	std::string mode;
+};
+
+/*
+ * One simtempN instance, addressed like SimtempDevice in the Python CLI:
+ * by position in numeric order under the sysfs class root.
+ */
+class Device {
+public:
+	Device(const std::string &sysfs_root, unsigned index,
+	       const std::string &char_device = std::string());
+
+	/* simtempN directories under @sysfs_root, simtemp10 after simtemp9. */
+	static std::vector<std::string> list(const std::string &sysfs_root);
+
+	const std::string &name() const { return name_; }
+	const std::string &sysfs_dir() const { return sysfs_dir_; }
+	const std::string &char_device() const { return char_device_; }
+
+	long long read_int(const std::string &attr) const;
+	std::string read_str(const std::string &attr) const;
+	void write(const std::string &attr, const std::string &value) const;
+
+	/* sampling_us, or sampling_ms on kernels without it. */
+	void write_sampling_us(std::uint32_t sampling_us) const;
+	Config snapshot() const;
+
+	/* Offset that turns this device's timestamps into wall-clock time. */
+	std::int64_t clock_offset_ns() const;
+
+private:
+	std::string name_;
+	std::string sysfs_dir_;
+	std::string char_device_;
+};
+
+/* Records returned by one Reader::read(); valid until the next call. */
+class SampleSpan {
+public:
+	SampleSpan() = default;
+	SampleSpan(const simtemp_sample *data, std::size_t size)
+		: data_(data), size_(size) {}
+
+	const simtemp_sample *begin() const { return data_; }
+	const simtemp_sample *end() const { return data_ + size_; }
+	const simtemp_sample &operator[](std::size_t i) const { return data_[i]; }
+	std::size_t size() const { return size_; }
+	bool empty() const { return size_ == 0; }
+
+private:
+	const simtemp_sample *data_ = nullptr;
+	std::size_t size_ = 0;
+};
+
+/*
+ * Non-blocking reader of the raw sample stream. Each read() is one syscall
+ * for up to batch() records into the reader's own buffer, and sequence gaps
+ * (samples overwritten or dropped before this reader got them) are counted.
+ */
+class Reader {
+public:
+	explicit Reader(const std::string &path,
+			std::size_t batch = kDefaultReadBatch);
+	Reader(FileDescriptor fd, std::size_t batch = kDefaultReadBatch);
+
+	int fd() const { return fd_.get(); }
+	std::size_t batch() const { return buffer_.size(); }
+
+	/* Empty span when nothing is queued; throws on other errors. */
+	SampleSpan read();
+
+	std::uint64_t samples() const { return samples_; }
+	std::uint64_t lost() const { return lost_; }
+
+	simtemp_stats stats() const;
+	/* Newest sample without consuming it; false before the first one. */
+	bool latest(simtemp_sample &out) const;
+
+private:
+	FileDescriptor fd_;
+	std::vector<simtemp_sample> buffer_;
+	std::uint64_t samples_ = 0;
+	std::uint64_t lost_ = 0;
+	std::uint64_t prev_seq_ = 0;
+	bool have_seq_ = false;
+};
+
+/*
+ * Level-triggered epoll loop over any number of readers. Handlers run on
+ * the caller's thread from poll_once(); a ready reader is drained until a
+ * read comes back short, so one wakeup costs one epoll_wait() plus one
+ * read() per batch.
+ */
+class Poller {
+public:
+	using Handler = std::function<void(Reader &, SampleSpan)>;
+
+	Poller();
+
+	/* @reader must outlive the poller. */
+	void add(Reader &reader, Handler handler);
+
+	/* Wait up to @timeout_ms; returns the samples delivered (0 on EINTR). */
+	std::size_t poll_once(int timeout_ms);
+
+private:
+	struct Entry {
+		Reader *reader;
+		Handler handler;
+	};
+
+	FileDescriptor epoll_fd_;
+	std::vector<Entry> entries_;
+	std::vector<epoll_event> events_;
+};
+
+/*
+ * Formats @sample like the Python CLI's stream output, without the newline,
+ * into @buf. Returns the length snprintf() would have written.
+ */
+int format_sample(const simtemp_sample &sample, std::int64_t offset_ns,
+		  char *buf, std::size_t len);
+
+/* CLOCK_REALTIME minus the clock named by a timestamp_clock value. */
+std::int64_t clock_offset_ns(const std::string &clock);
+
+} // namespace simtemp
+
+#endif // SIMTEMP_SIMTEMP_HPP
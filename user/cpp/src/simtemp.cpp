@@ -0,0 +1,377 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "simtemp/simtemp.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace simtemp {
+
+namespace {
+
+constexpr std::uint32_t kFlagAlert = SIMTEMP_SAMPLE_FLAG_THRESHOLD_ALERT;
+constexpr std::int64_t kNsPerSec = 1000000000;
+
+[[noreturn]] void throw_errno(const std::string &what)
+{
+	throw std::system_error(errno, std::generic_category(), what);
+}
+
+/* Trailing digits of simtempN, or -1 for names without a number. */
+long instance_number(const std::string &name)
+{
+	const std::string prefix = "simtemp";
+	std::string suffix = name.substr(prefix.size());
+
+	if (suffix.empty() ||
+	    !std::all_of(suffix.begin(), suffix.end(),
+			 [](unsigned char c) { return c >= '0' && c <= '9'; }))
+		return -1;
+	return std::stol(suffix);
+}
+
+std::int64_t clock_ns(clockid_t clock)
+{
+	timespec ts;
+
+	if (clock_gettime(clock, &ts) != 0)
+		throw_errno("clock_gettime");
+	return static_cast<std::int64_t>(ts.tv_sec) * kNsPerSec + ts.tv_nsec;
+}
+
+} // namespace
+
+FileDescriptor &FileDescriptor::operator=(FileDescriptor &&other) noexcept
+{
+	if (this != &other)
+		reset(other.release());
+	return *this;
+}
+
+int FileDescriptor::release()
+{
+	return std::exchange(fd_, -1);
+}
+
+void FileDescriptor::reset(int fd)
+{
+	if (fd_ >= 0)
+		::close(fd_);
+	fd_ = fd;
+}
+
+std::vector<std::string> Device::list(const std::string &sysfs_root)
+{
+	std::vector<std::string> names;
+	std::error_code ec;
+
+	if (!fs::exists(sysfs_root, ec))
+		throw std::system_error(ENOENT, std::generic_category(),
+					"sysfs root " + sysfs_root + " does not exist");
+
+	for (const auto &entry : fs::directory_iterator(sysfs_root)) {
+		std::string name = entry.path().filename().string();
+
+		if (name.rfind("simtemp", 0) == 0 && entry.is_directory())
+			names.push_back(name);
+	}
+
+	std::sort(names.begin(), names.end(),
+		  [](const std::string &a, const std::string &b) {
+			  long na = instance_number(a);
+			  long nb = instance_number(b);
+
+			  if (na < 0 || nb < 0 || na == nb)
+				  return std::make_pair(na < 0, a) < std::make_pair(nb < 0, b);
+			  return na < nb;
+		  });
+	return names;
+}
+
+Device::Device(const std::string &sysfs_root, unsigned index,
+	       const std::string &char_device)
+{
+	std::vector<std::string> names = list(sysfs_root);
+
+	if (names.empty())
+		throw std::system_error(ENOENT, std::generic_category(),
+					"no simtemp devices under " + sysfs_root);
+	if (index >= names.size())
+		throw std::out_of_range("requested device index " +
+					std::to_string(index) + " out of range (0-" +
+					std::to_string(names.size() - 1) + ")");
+
+	name_ = names[index];
+	sysfs_dir_ = (fs::path(sysfs_root) / name_).string();
+	char_device_ = char_device.empty() ?
+		(fs::path(kDefaultDevRoot) / name_).string() : char_device;
+}
+
+std::string Device::read_str(const std::string &attr) const
+{
+	std::string path = sysfs_dir_ + "/" + attr;
+	FileDescriptor fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+	char buf[4096];
+	ssize_t n;
+
+	if (!fd)
+		throw_errno(path);
+	n = ::read(fd.get(), buf, sizeof(buf));
+	if (n < 0)
+		throw_errno(path);
+
+	std::string value(buf, static_cast<std::size_t>(n));
+	while (!value.empty() &&
+	       (value.back() == '\n' || value.back() == ' '))
+		value.pop_back();
+	return value;
+}
+
+long long Device::read_int(const std::string &attr) const
+{
+	std::string value = read_str(attr);
+
+	try {
+		return std::stoll(value, nullptr, 0);
+	} catch (const std::exception &) {
+		throw std::system_error(EINVAL, std::generic_category(),
+					sysfs_dir_ + "/" + attr + ": '" + value +
+					"' is not an integer");
+	}
+}
+
+void Device::write(const std::string &attr, const std::string &value) const
+{
+	std::string path = sysfs_dir_ + "/" + attr;
+	std::string line = value + "\n";
+	/* No O_CREAT: a missing attribute is ENOENT, as on sysfs. */
+	FileDescriptor fd(::open(path.c_str(), O_WRONLY | O_TRUNC | O_CLOEXEC));
+
+	if (!fd)
+		throw_errno(path);
+	if (::write(fd.get(), line.data(), line.size()) < 0)
+		throw_errno(path);
+}
+
+void Device::write_sampling_us(std::uint32_t sampling_us) const
+{
+	try {
+		write("sampling_us", std::to_string(sampling_us));
+	} catch (const std::system_error &err) {
+		if (err.code() != std::errc::no_such_file_or_directory)
+			throw;
+		/* Fall back to the millisecond attribute on older kernels. */
+		write("sampling_ms",
+		      std::to_string(std::max<std::uint32_t>(1, sampling_us / 1000)));
+	}
+}
+
+Config Device::snapshot() const
+{
+	Config cfg;
+
+	try {
+		cfg.sampling_us = static_cast<std::uint32_t>(read_int("sampling_us"));
+	} catch (const std::system_error &err) {
+		if (err.code() != std::errc::no_such_file_or_directory)
+			throw;
+		cfg.sampling_us = static_cast<std::uint32_t>(read_int("sampling_ms") * 1000);
+	}
+	cfg.threshold_mc = static_cast<std::int32_t>(read_int("threshold_mC"));
+	cfg.mode = read_str("mode");
+	return cfg;
+}
+
+std::int64_t Device::clock_offset_ns() const
+{
+	std::string clock;
+
+	try {
+		clock = read_str("timestamp_clock");
+	} catch (const std::system_error &err) {
+		if (err.code() != std::errc::no_such_file_or_directory)
+			throw;
+		/* Older kernels always stamped with CLOCK_REALTIME. */
+		clock = "realtime";
+	}
+	return simtemp::clock_offset_ns(clock);
+}
+
+std::int64_t clock_offset_ns(const std::string &clock)
+{
+	static const std::pair<const char *, clockid_t> clocks[] = {
+		{ "realtime", CLOCK_REALTIME },
+		{ "monotonic", CLOCK_MONOTONIC },
+		{ "monotonic-raw", CLOCK_MONOTONIC_RAW },
+		{ "realtime-coarse", CLOCK_REALTIME_COARSE },
+		{ "monotonic-coarse", CLOCK_MONOTONIC_COARSE },
+		{ "boottime", CLOCK_BOOTTIME },
+	};
+
+	for (const auto &entry : clocks) {
+		if (clock != entry.first)
+			continue;
+		if (entry.second == CLOCK_REALTIME)
+			return 0;
+		return clock_ns(CLOCK_REALTIME) - clock_ns(entry.second);
+	}
+	throw std::invalid_argument("unknown timestamp clock '" + clock + "'");
+}
+
+Reader::Reader(const std::string &path, std::size_t batch)
+	: Reader(FileDescriptor(::open(path.c_str(),
+				       O_RDONLY | O_NONBLOCK | O_CLOEXEC)),
+		 batch)
+{
+	if (!fd_)
+		throw_errno(path);
+}
+
+Reader::Reader(FileDescriptor fd, std::size_t batch)
+	: fd_(std::move(fd)), buffer_(std::max<std::size_t>(batch, 1))
+{
+}
+
+SampleSpan Reader::read()
+{
+	ssize_t n;
+	std::size_t count;
+
+	do {
+		n = ::read(fd_.get(), buffer_.data(),
+			   buffer_.size() * sizeof(simtemp_sample));
+	} while (n < 0 && errno == EINTR);
+	if (n < 0) {
+		if (errno == EAGAIN)
+			return SampleSpan();
+		throw_errno("read");
+	}
+
+	/* Trailing bytes that do not form a whole record are ignored. */
+	count = static_cast<std::size_t>(n) / sizeof(simtemp_sample);
+	for (std::size_t i = 0; i < count; i++) {
+		std::uint64_t seq = buffer_[i].seq;
+
+		if (have_seq_ && seq > prev_seq_ + 1)
+			lost_ += seq - prev_seq_ - 1;
+		prev_seq_ = seq;
+		have_seq_ = true;
+	}
+	samples_ += count;
+
+	return SampleSpan(buffer_.data(), count);
+}
+
+simtemp_stats Reader::stats() const
+{
+	simtemp_stats stats = {};
+
+	if (::ioctl(fd_.get(), SIMTEMP_IOC_GET_STATS, &stats) != 0)
+		throw_errno("SIMTEMP_IOC_GET_STATS");
+	return stats;
+}
+
+bool Reader::latest(simtemp_sample &out) const
+{
+	if (::ioctl(fd_.get(), SIMTEMP_IOC_GET_LATEST, &out) == 0)
+		return true;
+	if (errno == ENODATA)
+		return false;
+	throw_errno("SIMTEMP_IOC_GET_LATEST");
+}
+
+Poller::Poller() : epoll_fd_(::epoll_create1(EPOLL_CLOEXEC))
+{
+	if (!epoll_fd_)
+		throw_errno("epoll_create1");
+}
+
+void Poller::add(Reader &reader, Handler handler)
+{
+	epoll_event ev = {};
+
+	/*
+	 * POLLIN only: POLLPRI stays asserted until alerts are fetched with
+	 * SIMTEMP_IOC_GET_ALERT, which this loop does not do.
+	 */
+	ev.events = EPOLLIN;
+	ev.data.u64 = entries_.size();
+	if (::epoll_ctl(epoll_fd_.get(), EPOLL_CTL_ADD, reader.fd(), &ev) != 0)
+		throw_errno("epoll_ctl");
+
+	entries_.push_back({ &reader, std::move(handler) });
+	events_.resize(entries_.size());
+}
+
+std::size_t Poller::poll_once(int timeout_ms)
+{
+	std::size_t delivered = 0;
+	int n;
+
+	if (entries_.empty())
+		return 0;
+
+	n = ::epoll_wait(epoll_fd_.get(), events_.data(),
+			 static_cast<int>(events_.size()), timeout_ms);
+	if (n < 0) {
+		if (errno == EINTR)
+			return 0;
+		throw_errno("epoll_wait");
+	}
+
+	for (int i = 0; i < n; i++) {
+		Entry &entry = entries_[events_[i].data.u64];
+
+		for (;;) {
+			SampleSpan batch = entry.reader->read();
+
+			if (!batch.empty()) {
+				entry.handler(*entry.reader, batch);
+				delivered += batch.size();
+			}
+			if (batch.size() < entry.reader->batch())
+				break;
+		}
+	}
+	return delivered;
+}
+
+int format_sample(const simtemp_sample &sample, std::int64_t offset_ns,
+		  char *buf, std::size_t len)
+{
+	std::int64_t ns = static_cast<std::int64_t>(sample.timestamp_ns) + offset_ns;
+	std::int64_t secs = ns / kNsPerSec;
+	std::int64_t rem = ns % kNsPerSec;
+	std::int32_t temp_mc = sample.temp_mc;
+	time_t t;
+	tm utc;
+
+	if (rem < 0) {
+		rem += kNsPerSec;
+		secs--;
+	}
+	t = static_cast<time_t>(secs);
+	gmtime_r(&t, &utc);
+
+	return std::snprintf(buf, len,
+			     "%04d-%02d-%02dT%02d:%02d:%02d.%03d+00:00 temp=%.1fC alert=%d flags=0x%02x seq=%" PRIu64,
+			     utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday,
+			     utc.tm_hour, utc.tm_min, utc.tm_sec,
+			     static_cast<int>(rem / 1000000), temp_mc / 1000.0,
+			     (sample.flags & kFlagAlert) ? 1 : 0,
+			     sample.flags, static_cast<std::uint64_t>(sample.seq));
+}
+
+} // namespace simtemp
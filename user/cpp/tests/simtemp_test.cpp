@@ -0,0 +1,186 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Unit checks for the simtemp client library against a fake sysfs tree and
+ * pipes standing in for /dev/simtempN; no driver needed.
+ */
+#include "simtemp/simtemp.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+int failures;
+
+#define CHECK(cond)                                                            \
+	do {                                                                   \
+		if (!(cond)) {                                                 \
+			std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n",      \
+				     __FILE__, __LINE__, #cond);               \
+			failures++;                                            \
+		}                                                              \
+	} while (0)
+
+void put(const fs::path &path, const std::string &text)
+{
+	std::ofstream(path) << text;
+}
+
+std::string get(const fs::path &path)
+{
+	std::ifstream in(path);
+	return std::string(std::istreambuf_iterator<char>(in), {});
+}
+
+fs::path make_sysfs()
+{
+	char tmpl[] = "/tmp/simtemp-test-XXXXXX";
+	fs::path root = mkdtemp(tmpl);
+
+	for (const char *name : { "simtemp10", "simtemp2", "simtemp0" }) {
+		fs::create_directory(root / name);
+		put(root / name / "sampling_us", "100000\n");
+		put(root / name / "threshold_mC", "45000\n");
+		put(root / name / "mode", "normal\n");
+	}
+	/* simtemp2 predates sampling_us and timestamp_clock. */
+	fs::remove(root / "simtemp2" / "sampling_us");
+	put(root / "simtemp2" / "sampling_ms", "100\n");
+	put(root / "simtemp0" / "timestamp_clock", "realtime\n");
+	return root;
+}
+
+void test_device(const fs::path &root)
+{
+	simtemp::Device dev0(root.string(), 0);
+	simtemp::Device dev1(root.string(), 1);
+	simtemp::Device dev2(root.string(), 2, "/tmp/custom");
+	bool threw = false;
+
+	CHECK(dev0.name() == "simtemp0");
+	CHECK(dev1.name() == "simtemp2");
+	CHECK(dev2.name() == "simtemp10");
+	CHECK(dev0.char_device() == "/dev/simtemp0");
+	CHECK(dev2.char_device() == "/tmp/custom");
+
+	try {
+		simtemp::Device bad(root.string(), 3);
+	} catch (const std::out_of_range &) {
+		threw = true;
+	}
+	CHECK(threw);
+
+	CHECK(dev0.read_int("threshold_mC") == 45000);
+	CHECK(dev0.read_str("mode") == "normal");
+	dev0.write("threshold_mC", "20000");
+	CHECK(get(root / "simtemp0" / "threshold_mC") == "20000\n");
+
+	simtemp::Config cfg = dev0.snapshot();
+	CHECK(cfg.sampling_us == 100000);
+	CHECK(cfg.threshold_mc == 20000);
+	CHECK(cfg.mode == "normal");
+
+	/* Older kernels: fall back to sampling_ms both ways. */
+	CHECK(dev1.snapshot().sampling_us == 100000);
+	dev1.write_sampling_us(5000);
+	CHECK(get(root / "simtemp2" / "sampling_ms") == "5\n");
+	CHECK(!fs::exists(root / "simtemp2" / "sampling_us"));
+
+	CHECK(dev0.clock_offset_ns() == 0);
+	CHECK(dev1.clock_offset_ns() == 0);
+}
+
+simtemp_sample sample(std::uint64_t seq, std::int32_t temp_mc, std::uint32_t flags)
+{
+	simtemp_sample s = {};
+
+	s.timestamp_ns = 1500000000ULL + seq;
+	s.temp_mc = temp_mc;
+	s.flags = flags;
+	s.seq = seq;
+	return s;
+}
+
+void test_reader()
+{
+	int fds[2];
+	simtemp_sample in[3] = {
+		sample(7, 45000, 0x1), sample(8, 45100, 0x1), sample(11, 45200, 0x3),
+	};
+
+	CHECK(pipe2(fds, O_NONBLOCK) == 0);
+	simtemp::Reader reader(simtemp::FileDescriptor(fds[0]), 2);
+	simtemp::FileDescriptor wr(fds[1]);
+
+	CHECK(reader.read().empty());
+
+	CHECK(write(wr.get(), in, sizeof(in)) == sizeof(in));
+	simtemp::SampleSpan batch = reader.read();
+	CHECK(batch.size() == 2);
+	CHECK(batch[0].seq == 7 && batch[1].temp_mc == 45100);
+	batch = reader.read();
+	CHECK(batch.size() == 1);
+	CHECK(batch[0].seq == 11);
+	CHECK(reader.samples() == 3);
+	CHECK(reader.lost() == 2);
+
+	/* A poller drains the reader in batch-sized reads. */
+	simtemp::Poller poller;
+	std::size_t seen = 0;
+
+	poller.add(reader, [&](simtemp::Reader &, simtemp::SampleSpan span) {
+		seen += span.size();
+	});
+	CHECK(poller.poll_once(0) == 0);
+	CHECK(write(wr.get(), in, sizeof(in)) == sizeof(in));
+	CHECK(poller.poll_once(1000) == 3);
+	CHECK(seen == 3);
+}
+
+void test_format()
+{
+	char line[128];
+	simtemp_sample s = sample(42, 45049, 0x3);
+
+	s.timestamp_ns = 1500ULL * 1000000ULL;
+	simtemp::format_sample(s, 1000000000LL, line, sizeof(line));
+	CHECK(std::strcmp(line,
+			  "1970-01-01T00:00:02.500+00:00 temp=45.0C alert=1 flags=0x03 seq=42") == 0);
+
+	s.flags = 0x1;
+	s.temp_mc = -1250;
+	simtemp::format_sample(s, 0, line, sizeof(line));
+	CHECK(std::strcmp(line,
+			  "1970-01-01T00:00:01.500+00:00 temp=-1.2C alert=0 flags=0x01 seq=42") == 0);
+}
+
+} // namespace
+
+int main()
+{
+	fs::path root = make_sysfs();
+
+	try {
+		test_device(root);
+		test_reader();
+		test_format();
+	} catch (const std::exception &err) {
+		std::fprintf(stderr, "unexpected exception: %s\n", err.what());
+		failures++;
+	}
+	fs::remove_all(root);
+
+	if (failures)
+		std::fprintf(stderr, "%d check(s) failed\n", failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,276 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * simtemp-stream - print or count samples from one or more simtemp devices.
+ *
+ * The native counterpart of `main.py stream`: same sysfs options and output
+ * format, but every device is drained from one epoll loop with batched
+ * reads, and output is formatted into one reusable buffer per batch.
+ */
+#include "simtemp/simtemp.hpp"
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <getopt.h>
+
+namespace {
+
+constexpr int kPollTimeoutMs = 1000;
+/* Longest format_sample() line plus a "simtempNN " prefix and newline. */
+constexpr std::size_t kLineMax = 128;
+
+volatile std::sig_atomic_t stop_requested;
+
+void on_signal(int)
+{
+	stop_requested = 1;
+}
+
+struct Options {
+	std::string sysfs_root = simtemp::kDefaultSysfsRoot;
+	std::string device;
+	std::vector<unsigned> indices;
+	bool all = false;
+	std::optional<unsigned long long> count;
+	std::optional<double> duration;
+	std::optional<unsigned> sampling_us;
+	std::optional<int> threshold_mc;
+	std::string mode;
+	std::size_t batch = simtemp::kDefaultReadBatch;
+	bool quiet = false;
+};
+
+struct Stream {
+	std::unique_ptr<simtemp::Device> device;
+	std::unique_ptr<simtemp::Reader> reader;
+	std::int64_t offset_ns;
+};
+
+void usage(const char *prog)
+{
+	std::fprintf(stderr,
+		     "usage: %s [options]\n"
+		     "  --sysfs-root PATH    simtemp class root (default: %s)\n"
+		     "  --index N            device index, repeat for several devices (default: 0)\n"
+		     "  --all                stream every device under the sysfs root\n"
+		     "  --device PATH        character device (single --index only)\n"
+		     "  --count N            stop after N samples in total\n"
+		     "  --duration SECONDS   stop after this long\n"
+		     "  --sampling-us US     update the sampling period first\n"
+		     "  --threshold-mc MC    update the threshold first\n"
+		     "  --mode MODE          update the mode first\n"
+		     "  --batch N            records per read() (default: %zu)\n"
+		     "  --quiet              count samples instead of printing them\n",
+		     prog, simtemp::kDefaultSysfsRoot, simtemp::kDefaultReadBatch);
+}
+
+unsigned long long parse_positive(const char *arg, const char *opt)
+{
+	char *end;
+	unsigned long long value = std::strtoull(arg, &end, 0);
+
+	if (*arg == '\0' || *end != '\0' || value == 0) {
+		std::fprintf(stderr, "%s: value must be > 0\n", opt);
+		std::exit(2);
+	}
+	return value;
+}
+
+bool parse_args(int argc, char **argv, Options &opts)
+{
+	enum { OPT_SYSFS_ROOT = 256, OPT_INDEX, OPT_ALL, OPT_DEVICE, OPT_COUNT,
+	       OPT_DURATION, OPT_SAMPLING_US, OPT_THRESHOLD_MC, OPT_MODE,
+	       OPT_BATCH, OPT_QUIET, OPT_HELP };
+	static const option long_opts[] = {
+		{ "sysfs-root", required_argument, nullptr, OPT_SYSFS_ROOT },
+		{ "index", required_argument, nullptr, OPT_INDEX },
+		{ "all", no_argument, nullptr, OPT_ALL },
+		{ "device", required_argument, nullptr, OPT_DEVICE },
+		{ "count", required_argument, nullptr, OPT_COUNT },
+		{ "duration", required_argument, nullptr, OPT_DURATION },
+		{ "sampling-us", required_argument, nullptr, OPT_SAMPLING_US },
+		{ "threshold-mc", required_argument, nullptr, OPT_THRESHOLD_MC },
+		{ "mode", required_argument, nullptr, OPT_MODE },
+		{ "batch", required_argument, nullptr, OPT_BATCH },
+		{ "quiet", no_argument, nullptr, OPT_QUIET },
+		{ "help", no_argument, nullptr, OPT_HELP },
+		{ nullptr, 0, nullptr, 0 },
+	};
+	int opt;
+
+	while ((opt = getopt_long(argc, argv, "", long_opts, nullptr)) != -1) {
+		switch (opt) {
+		case OPT_SYSFS_ROOT:
+			opts.sysfs_root = optarg;
+			break;
+		case OPT_INDEX:
+			opts.indices.push_back(static_cast<unsigned>(std::strtoul(optarg, nullptr, 0)));
+			break;
+		case OPT_ALL:
+			opts.all = true;
+			break;
+		case OPT_DEVICE:
+			opts.device = optarg;
+			break;
+		case OPT_COUNT:
+			opts.count = parse_positive(optarg, "--count");
+			break;
+		case OPT_DURATION:
+			opts.duration = std::strtod(optarg, nullptr);
+			break;
+		case OPT_SAMPLING_US:
+			opts.sampling_us = static_cast<unsigned>(parse_positive(optarg, "--sampling-us"));
+			break;
+		case OPT_THRESHOLD_MC:
+			opts.threshold_mc = static_cast<int>(std::strtol(optarg, nullptr, 0));
+			break;
+		case OPT_MODE:
+			opts.mode = optarg;
+			break;
+		case OPT_BATCH:
+			opts.batch = parse_positive(optarg, "--batch");
+			break;
+		case OPT_QUIET:
+			opts.quiet = true;
+			break;
+		default:
+			return false;
+		}
+	}
+	if (optind != argc)
+		return false;
+
+	if (opts.all) {
+		opts.indices.clear();
+		for (std::size_t i = 0; i < simtemp::Device::list(opts.sysfs_root).size(); i++)
+			opts.indices.push_back(static_cast<unsigned>(i));
+	} else if (opts.indices.empty()) {
+		opts.indices.push_back(0);
+	}
+	if (!opts.device.empty() && opts.indices.size() != 1) {
+		std::fprintf(stderr, "--device needs exactly one device\n");
+		return false;
+	}
+	return true;
+}
+
+int run(const Options &opts)
+{
+	using clock = std::chrono::steady_clock;
+	const bool prefix = opts.indices.size() > 1;
+	std::vector<Stream> streams;
+	std::vector<char> out(opts.batch * kLineMax);
+	unsigned long long total = 0;
+	simtemp::Poller poller;
+	clock::time_point start, deadline;
+
+	streams.reserve(opts.indices.size());
+	for (unsigned index : opts.indices) {
+		auto device = std::make_unique<simtemp::Device>(opts.sysfs_root, index,
+								opts.device);
+
+		if (opts.sampling_us)
+			device->write_sampling_us(*opts.sampling_us);
+		if (opts.threshold_mc)
+			device->write("threshold_mC", std::to_string(*opts.threshold_mc));
+		if (!opts.mode.empty())
+			device->write("mode", opts.mode);
+
+		auto reader = std::make_unique<simtemp::Reader>(device->char_device(),
+								opts.batch);
+		std::int64_t offset_ns = device->clock_offset_ns();
+
+		streams.push_back({ std::move(device), std::move(reader), offset_ns });
+	}
+
+	for (Stream &stream : streams) {
+		const Stream *s = &stream;
+
+		poller.add(*stream.reader, [&, s](simtemp::Reader &, simtemp::SampleSpan batch) {
+			std::size_t n = batch.size();
+			std::size_t len = 0;
+
+			if (opts.count && total + n > *opts.count)
+				n = *opts.count - total;
+			total += n;
+			if (opts.quiet)
+				return;
+
+			for (std::size_t i = 0; i < n; i++) {
+				char *line = out.data() + len;
+				std::size_t room = out.size() - len;
+				int w = 0;
+
+				if (prefix)
+					w = std::snprintf(line, room, "%s ", s->device->name().c_str());
+				w += simtemp::format_sample(batch[i], s->offset_ns, line + w, room - w);
+				len += std::min<std::size_t>(static_cast<std::size_t>(w), room - 2);
+				out[len++] = '\n';
+			}
+			std::fwrite(out.data(), 1, len, stdout);
+		});
+	}
+
+	start = clock::now();
+	if (opts.duration)
+		deadline = start + std::chrono::duration_cast<clock::duration>(
+			std::chrono::duration<double>(*opts.duration));
+
+	while (!stop_requested) {
+		int timeout = kPollTimeoutMs;
+
+		if (opts.count && total >= *opts.count)
+			break;
+		if (opts.duration) {
+			auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+				deadline - clock::now()).count();
+
+			if (left <= 0)
+				break;
+			timeout = static_cast<int>(std::min<long long>(left, timeout));
+		}
+		poller.poll_once(timeout);
+	}
+	std::fflush(stdout);
+
+	double secs = std::chrono::duration<double>(clock::now() - start).count();
+	for (const Stream &stream : streams) {
+		std::fprintf(stderr, "# %s: %llu sample(s), %llu lost, %.0f samples/s\n",
+			     stream.device->name().c_str(),
+			     static_cast<unsigned long long>(stream.reader->samples()),
+			     static_cast<unsigned long long>(stream.reader->lost()),
+			     secs > 0 ? stream.reader->samples() / secs : 0.0);
+	}
+	return 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+	Options opts;
+	struct sigaction sa = {};
+
+	sa.sa_handler = on_signal;
+	sigaction(SIGINT, &sa, nullptr);
+	sigaction(SIGTERM, &sa, nullptr);
+
+	try {
+		if (!parse_args(argc, argv, opts)) {
+			usage(argv[0]);
+			return 2;
+		}
+		return run(opts);
+	} catch (const std::exception &err) {
+		std::fprintf(stderr, "error: %s\n", err.what());
+		return 1;
+	}
+}